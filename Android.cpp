@@ -15,6 +15,9 @@
 #include <math.h>
 #include <time.h>
 #include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
 
 #include <Poco/File.h>
 #include <Poco/FileStream.h>
@@ -185,6 +188,60 @@ void Droid_BinaryRead(const char *filename, void *data, size_t size) {
 	inStream.close();
 }
 
+// uncompressed, unlike binaryWrite, so that parts of the file can be replaced
+void Droid_BinaryWriteAt(const char *filename, size_t offset, const void *data, size_t size) {
+	static char fnbuf[1024];
+	createDirIfNeeded();
+	strcpy(fnbuf, extPath);
+	strcat(fnbuf, filename);
+	FILE *fp = fopen(fnbuf, "r+b");
+	if (!fp)
+		fp = fopen(fnbuf, "w+b");
+	if (fp) {
+		fseek(fp, offset, SEEK_SET);
+		fwrite(data, size, 1, fp);
+		fclose(fp);
+	} else {
+		LOGE("Error writing file: %s!", fnbuf);
+	}
+}
+
+void Droid_BinaryReadAt(const char *filename, size_t offset, void *data, size_t size) {
+	static char fnbuf[1024];
+	strcpy(fnbuf, extPath);
+	strcat(fnbuf, filename);
+	FILE *fp = fopen(fnbuf, "rb");
+	if (fp) {
+		fseek(fp, offset, SEEK_SET);
+		fread(data, size, 1, fp);
+		fclose(fp);
+	} else {
+		LOGE("Error reading file: %s!", fnbuf);
+	}
+}
+
+const void *Droid_MapFile(const char *filename, size_t *size) {
+	static char fnbuf[1024];
+	strcpy(fnbuf, extPath);
+	strcat(fnbuf, filename);
+	int fd = open(fnbuf, O_RDONLY);
+	if (fd < 0) return NULL;
+
+	struct stat st;
+	void *data = NULL;
+	if (fstat(fd, &st) == 0 && st.st_size > 0) {
+		data = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+		if (data == MAP_FAILED) data = NULL;
+		*size = st.st_size;
+	}
+	close(fd);
+	return data;
+}
+
+void Droid_UnmapFile(const void *data, size_t size) {
+	munmap((void *)data, size);
+}
+
 std::string Droid_ReadText(const char *filename) {
 	static char fnbuf[1024];
 	strcpy(fnbuf, extPath);
@@ -219,6 +276,16 @@ void Droid_DeleteFile(const char *filename) {
 	remove(fnbuf);
 }
 
+void Droid_RenameFile(const char *from, const char *to) {
+	static char fromBuf[1024], toBuf[1024];
+	strcpy(fromBuf, extPath);
+	strcat(fromBuf, from);
+	strcpy(toBuf, extPath);
+	strcat(toBuf, to);
+	if (rename(fromBuf, toBuf) != 0)
+		LOGE("Error renaming file: %s!", fromBuf);
+}
+
 void Droid_ToggleTexture(int _activeTexMap) {
 	textureToggleReq = true;
 	activeTexMap = _activeTexMap;
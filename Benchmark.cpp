@@ -0,0 +1,157 @@
+// Benchmark.cpp
+
+
+
+#include <chrono>
+#include <cstdio>
+#include <vector>
+
+#include "Framework/Math/Noise.hpp"
+#include "Framework/Math/Random.hpp"
+#include "Rendering/Meshes/ChunkMesh.hpp"
+
+#include "Benchmark.hpp"
+
+namespace as {
+
+static const int SEED			= 1234;
+// columns loaded around the center, the meshes leave out the outermost ring
+static const int RADIUS			= 4;
+static const int MESH_ROUNDS	= 20;
+static const int NUM_RAYS		= 200000;
+static const int NUM_BODIES		= 2000000;
+static const float RAY_DIST		= 64.0f;
+
+static const char *LAYOUT_NAMES[] = { "linear", "morton", "bricks" };
+
+class Stopwatch {
+public:
+	Stopwatch() : start(std::chrono::steady_clock::now()) {}
+
+	double elapsedMs() const {
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	}
+
+private:
+	std::chrono::steady_clock::time_point start;
+};
+
+// the 6 neighbours of every block, the pattern of determining visible faces
+static void benchNeighbours(const Terrain *t, int minX, int maxX, int minZ, int maxZ) {
+	Stopwatch watch;
+	long long count = 0, lookups = 0;
+
+	for (int x = minX; x < maxX; x++) {
+		for (int y = 1; y < Terrain::MAX_Y - 1; y++) {
+			for (int z = minZ; z < maxZ; z++) {
+				count += (t->get(x - 1, y, z) != 0) + (t->get(x + 1, y, z) != 0)
+					+ (t->get(x, y - 1, z) != 0) + (t->get(x, y + 1, z) != 0)
+					+ (t->get(x, y, z - 1) != 0) + (t->get(x, y, z + 1) != 0);
+				lookups += 6;
+			}
+		}
+	}
+
+	double ms = watch.elapsedMs();
+	std::printf("neighbours: %.2f ns/lookup (%lld solid)\n", ms * 1e6 / lookups, count);
+}
+
+static void benchMeshing(Terrain *t, int cx, int cz) {
+	std::vector<ChunkMesh *> meshes;
+	for (int x = cx - RADIUS + 1; x < cx + RADIUS; x++) {
+		for (int z = cz - RADIUS + 1; z < cz + RADIUS; z++) {
+			int minX = x * Terrain::CHUNK_SIZE, minZ = z * Terrain::CHUNK_SIZE;
+			meshes.push_back(new ChunkMesh(t, minX, minX + Terrain::CHUNK_SIZE, minZ, minZ + Terrain::CHUNK_SIZE));
+		}
+	}
+
+	ChunkColumn::SectionMask all;
+	all.set();
+
+	// best round, the first ones also pay for allocating the buffers
+	double best = 0.0;
+	for (int r = 0; r < MESH_ROUNDS; r++) {
+		Stopwatch watch;
+		for (size_t i = 0; i < meshes.size(); i++) {
+			meshes[i]->update(all);
+		}
+		double ms = watch.elapsedMs();
+		if (r == 0 || ms < best)
+			best = ms;
+	}
+
+	std::printf("meshing: %.1f us/column (%d columns)\n", best * 1000.0 / meshes.size(), (int)meshes.size());
+
+	for (size_t i = 0; i < meshes.size(); i++) {
+		SAFE_DELETE(meshes[i]);
+	}
+}
+
+// from above the terrain down at random angles, like picking blocks while looking around
+static void benchRaycast(const Terrain *t, int minX, int maxX, int minZ, int maxZ) {
+	Random rng(SEED);
+	std::vector<Vec3> origins(NUM_RAYS), dirs(NUM_RAYS);
+	for (int i = 0; i < NUM_RAYS; i++) {
+		int x = minX + rng.nextInt(maxX - minX), z = minZ + rng.nextInt(maxZ - minZ);
+		origins[i] = Vec3(x + 0.5f, (float)(t->getYOfBlockBelow(x, Terrain::MAX_Y - 1, z) + 2), z + 0.5f);
+		dirs[i] = Vec3(rng.nextInt(2001) - 1000.0f, -(float)(1 + rng.nextInt(1000)), rng.nextInt(2001) - 1000.0f);
+		dirs[i].normalizeInPlace();
+	}
+
+	Stopwatch watch;
+	int hits = 0;
+	BlockHit hit;
+	for (int i = 0; i < NUM_RAYS; i++) {
+		hits += t->raycast(origins[i], dirs[i], RAY_DIST, &hit);
+	}
+
+	double ms = watch.elapsedMs();
+	std::printf("raycast: %.2f us/ray (%d hits)\n", ms * 1000.0 / NUM_RAYS, hits);
+}
+
+// what Movement asks each step: does the body fit and is there ground below
+static void benchCollision(const Terrain *t, int minX, int maxX, int minZ, int maxZ) {
+	Random rng(SEED + 1);
+	std::vector<BlockPos> bodies(NUM_BODIES);
+	for (int i = 0; i < NUM_BODIES; i++) {
+		bodies[i] = BlockPos(minX + rng.nextInt(maxX - minX), 2 + rng.nextInt(Terrain::MAX_Y - 2), minZ + rng.nextInt(maxZ - minZ));
+	}
+
+	Stopwatch watch;
+	int fits = 0, grounded = 0;
+	for (int i = 0; i < NUM_BODIES; i++) {
+		const BlockPos &b = bodies[i];
+		if (t->isEmptySpan(b.x, b.y - 1, b.y, b.z)) {
+			fits++;
+			grounded += t->get(b.x, b.y - 2, b.z) != 0;
+		}
+	}
+
+	double ms = watch.elapsedMs();
+	std::printf("collision: %.1f ns/query (%d fit, %d on ground)\n", ms * 1e6 / NUM_BODIES, fits, grounded);
+}
+
+bool runBenchmark() {
+	int c = Terrain::WORLD_CENTER / Terrain::CHUNK_SIZE;
+	int minX = (c - RADIUS + 1) * Terrain::CHUNK_SIZE, maxX = (c + RADIUS) * Terrain::CHUNK_SIZE;
+	int minZ = minX, maxZ = maxX;
+
+	Terrain *t = new Terrain(Terrain::TS_PERLIN, SEED);
+	t->loadColumnsAround(c, c, RADIUS);
+
+	std::printf("voxel layout: %s, %dx%dx%d sections\n", LAYOUT_NAMES[WorldConfig::VOXEL_LAYOUT],
+		(int)ChunkSection::EDGE, (int)ChunkSection::EDGE, (int)ChunkSection::EDGE);
+	bool noiseOk = checkNoiseBatch();
+	std::printf("noise batch: %s\n", noiseOk ? "ok" : "FAILED");
+
+	benchNeighbours(t, minX, maxX, minZ, maxZ);
+	benchMeshing(t, c, c);
+	benchRaycast(t, minX, maxX, minZ, maxZ);
+	benchCollision(t, minX, maxX, minZ, maxZ);
+
+	std::fflush(stdout);
+	SAFE_DELETE(t);
+	return noiseOk;
+}
+
+}
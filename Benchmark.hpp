@@ -0,0 +1,21 @@
+// Benchmark.hpp
+
+#ifndef BENCHMARK_HPP
+#define BENCHMARK_HPP
+
+namespace as {
+
+/**
+ Times the voxel access patterns which depend on the order of the voxels in
+ a section (WorldConfig::VOXEL_LAYOUT): neighbour lookups, meshing, raycasts
+ and collision queries, all on the same generated world. Also checks the
+ vector noise kernel of this build against the scalar noise(). Run it with the
+ "bench" argument in builds of different layouts (see BUILD_LAYOUT_VARIANTS
+ in CMakeLists.txt) to compare them. Needs a GL context for the meshes.
+ False if the noise check failed.
+*/
+bool runBenchmark();
+
+}
+
+#endif // BENCHMARK_HPP
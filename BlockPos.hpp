@@ -6,6 +6,7 @@
 #include "Framework/Math/Vector.hpp"
 
 #include <string>
+#include <cstddef>
 
 namespace as {
 /**
@@ -26,9 +27,12 @@ public:
 	BlockPos operator+(BlockPos const& o) const;
 
 	std::string toString() const;
+};
 
-private:
-	int getDataIndex() const;
+struct BlockPosHash {
+	size_t operator()(const BlockPos &p) const {
+		return (size_t)p.x * 73856093u ^ (size_t)p.y * 19349663u ^ (size_t)p.z * 83492791u;
+	}
 };
 
 inline bool BlockPos::operator==(const BlockPos& o) const {
@@ -36,7 +40,9 @@ inline bool BlockPos::operator==(const BlockPos& o) const {
 }
 
 inline bool BlockPos::operator<(const BlockPos& o) const {
-	return this->getDataIndex() < o.getDataIndex();
+	if (x != o.x) return x < o.x;
+	if (y != o.y) return y < o.y;
+	return z < o.z;
 }
 
 inline BlockPos BlockPos::operator+(BlockPos const& o) const {
@@ -0,0 +1,121 @@
+// BlockTypes.hpp
+
+#ifndef BLOCK_TYPES_HPP
+#define BLOCK_TYPES_HPP
+
+#include "Constants.h"
+#include "ChunkSection.hpp"
+
+namespace as {
+
+/**
+ Properties of a block value, looked up in a table built at compile time
+ (see blockType()). Block value v > 0 is drawn with texture cell v - 1
+ unless it is one of the special blocks below, so new plain blocks need no
+ entry at all and special ones only a case in makeBlockType().
+
+ Texture cells count row by row through the texture map, NUM_TEX_PER_ROW per row.
+*/
+struct BlockType {
+	enum Values {
+		AIR			= 0,
+		GRASS		= 1,
+		// sources, placed by the terrain generator
+		WATER		= 11,
+		FENCE		= 202,
+		// FluidManager's flowing water, one value per level 1..NUM_FLOW_LEVELS
+		FLOWING_WATER	= 240,
+		INVIS_SOLID	= 254,
+		INVIS_DOOR	= 255,
+
+		NUM_VALUES		= 256,
+		NUM_FLOW_LEVELS	= 7
+	};
+
+	enum Flags {
+		// hides the faces of its neighbours and blocks light
+		OPAQUE	= 1,
+		// collides, see ChunkColumn::isSolid()
+		SOLID	= 2
+	};
+
+	enum MeshKind {
+		MESH_NONE,
+		MESH_CUBE,
+		MESH_FENCE
+	};
+
+	enum TexSlot {
+		TEX_TOP,
+		TEX_SIDE,
+		TEX_BOTTOM,
+		// sides with an opaque block on top
+		TEX_COVERED_SIDE,
+		NUM_TEX_SLOTS
+	};
+
+	uchar flags;
+	uchar mesh;
+	uchar tex[NUM_TEX_SLOTS];
+
+	constexpr bool isOpaque() const { return (flags & OPAQUE) != 0; }
+	constexpr bool isSolid() const { return (flags & SOLID) != 0; }
+};
+
+constexpr BlockType makeBlockType(int flags, BlockType::MeshKind mesh, int top, int side, int bottom, int coveredSide) {
+	return BlockType { (uchar)flags, (uchar)mesh, { (uchar)top, (uchar)side, (uchar)bottom, (uchar)coveredSide } };
+}
+
+constexpr BlockType makeBlockType(int val) {
+	const int DIRT_CELL = 1, GRASS_SIDE_CELL = NUM_TEX_PER_ROW, FENCE_CELL = NUM_TEX_PER_ROW + 1;
+	const int WATER_CELL = BlockType::WATER - 1;
+
+	// looks like the source, only FluidManager tells them apart
+	if (val >= BlockType::FLOWING_WATER && val < BlockType::FLOWING_WATER + BlockType::NUM_FLOW_LEVELS)
+		val = BlockType::WATER;
+
+	switch (val) {
+		case BlockType::AIR:
+			return makeBlockType(0, BlockType::MESH_NONE, 0, 0, 0, 0);
+		case BlockType::GRASS:
+			return makeBlockType(BlockType::OPAQUE | BlockType::SOLID, BlockType::MESH_CUBE, 0, GRASS_SIDE_CELL, DIRT_CELL, DIRT_CELL);
+		case BlockType::WATER:
+			return makeBlockType(BlockType::OPAQUE | BlockType::SOLID, BlockType::MESH_CUBE, WATER_CELL, WATER_CELL, WATER_CELL, WATER_CELL);
+		case BlockType::FENCE:
+			return makeBlockType(BlockType::SOLID, BlockType::MESH_FENCE, FENCE_CELL, FENCE_CELL, FENCE_CELL, FENCE_CELL);
+		// placeholders of entities (glass, doors, ...) which draw themselves
+		case BlockType::INVIS_SOLID:
+		case BlockType::INVIS_DOOR:
+			return makeBlockType(BlockType::SOLID, BlockType::MESH_NONE, 0, 0, 0, 0);
+		default:
+			return makeBlockType(BlockType::OPAQUE | BlockType::SOLID, BlockType::MESH_CUBE, val - 1, val - 1, val - 1, val - 1);
+	}
+}
+
+struct BlockRegistry {
+	BlockType types[BlockType::NUM_VALUES];
+};
+
+constexpr BlockRegistry makeBlockRegistry() {
+	BlockRegistry registry = {};
+	for (int val = 0; val < BlockType::NUM_VALUES; val++) {
+		registry.types[val] = makeBlockType(val);
+	}
+	return registry;
+}
+
+inline constexpr BlockRegistry BLOCK_REGISTRY = makeBlockRegistry();
+
+static_assert(!BLOCK_REGISTRY.types[BlockType::AIR].isSolid(), "air must not collide");
+static_assert(BlockType::NUM_VALUES == 1 << (8 * sizeof(DATA_TYPE)), "one entry per block value");
+
+//===========================================================================
+// Inlined implementations
+//===========================================================================
+inline const BlockType &blockType(DATA_TYPE val) {
+	return BLOCK_REGISTRY.types[val];
+}
+
+}
+
+#endif // BLOCK_TYPES_HPP
@@ -0,0 +1,125 @@
+// ChunkColumn.cpp
+
+
+
+#include <cstring>
+
+#include "Framework/Utilities.hpp"
+#include "Framework/Compression.hpp"
+
+#include "ChunkColumn.hpp"
+
+namespace as {
+
+// in the order of ChunkColumn::exportBlocks()
+static void exportSections(const ChunkSection *sections, DATA_TYPE *dest) {
+	const int EDGE = ChunkColumn::EDGE, HEIGHT = ChunkColumn::HEIGHT;
+
+	for (int lx = 0; lx < EDGE; lx++) {
+		for (int y = 0; y < HEIGHT; y++) {
+			const ChunkSection &section = sections[y >> ChunkSection::EDGE_SHIFT];
+			for (int lz = 0; lz < EDGE; lz++) {
+				*dest++ = section.get(ChunkSection::localIndex(lx, y & ChunkSection::EDGE_MASK, lz));
+			}
+		}
+	}
+}
+
+static void encodeSections(const ChunkSection *sections, std::vector<uchar> *out) {
+	DATA_TYPE buf[ChunkColumn::NUM_BLOCKS];
+	exportSections(sections, buf);
+	compressLZ(buf, sizeof(buf), out);
+}
+
+ChunkColumn::ChunkColumn(int _cx, int _cz)
+:	modified(false),
+	cx(_cx),
+	cz(_cz)
+{
+	memset(solidBits, 0, sizeof(solidBits));
+	memset(skyHeights, 0, sizeof(skyHeights));
+	memset(topHeights, 0, sizeof(topHeights));
+}
+
+void ChunkColumn::clearLight() {
+	for (int i = 0; i < NUM_SECTIONS; i++) {
+		std::vector<uchar>().swap(light[i]);
+	}
+}
+
+void ChunkColumn::compact() {
+	for (int i = 0; i < NUM_SECTIONS; i++) {
+		sections[i].compact();
+	}
+}
+
+size_t ChunkColumn::memoryUsage() const {
+	size_t bytes = sizeof(ChunkColumn);
+	for (int i = 0; i < NUM_SECTIONS; i++) {
+		bytes += sections[i].memoryUsage() - sizeof(ChunkSection);
+		bytes += light[i].capacity();
+	}
+	bytes += solidSums.capacity() * sizeof(uint);
+	return bytes;
+}
+
+void ChunkColumn::exportBlocks(DATA_TYPE *dest) const {
+	exportSections(sections, dest);
+}
+
+void ChunkColumn::importBlocks(const DATA_TYPE *src) {
+	DATA_TYPE vals[ChunkSection::NUM_VOXELS];
+
+	for (int s = 0; s < NUM_SECTIONS; s++) {
+		for (int lx = 0; lx < EDGE; lx++) {
+			for (int ly = 0; ly < EDGE; ly++) {
+				const DATA_TYPE *row = &src[lx*(HEIGHT*EDGE) + (s*EDGE + ly)*EDGE];
+				for (int lz = 0; lz < EDGE; lz++) {
+					vals[ChunkSection::localIndex(lx, ly, lz)] = row[lz];
+				}
+			}
+		}
+		sections[s].assign(vals);
+	}
+
+	memset(solidBits, 0, sizeof(solidBits));
+	for (int lx = 0; lx < EDGE; lx++) {
+		for (int y = 0; y < HEIGHT; y++) {
+			for (int lz = 0; lz < EDGE; lz++) {
+				if (blockType(src[lx*(HEIGHT*EDGE) + y*EDGE + lz]).isSolid())
+					solidBits[(lx << ChunkSection::EDGE_SHIFT) | lz][y / SOLID_WORD_BITS] |= (SolidWord)1 << (y % SOLID_WORD_BITS);
+			}
+		}
+	}
+
+	invalidateSolidSums();
+	modified = true;
+}
+
+void ChunkColumn::encode(std::vector<uchar> *out) const {
+	encodeSections(sections, out);
+}
+
+bool ChunkColumn::decode(const uchar *data, size_t size) {
+	DATA_TYPE buf[NUM_BLOCKS];
+	if (!decompressLZ(data, size, buf, sizeof(buf)))
+		return false;
+
+	importBlocks(buf);
+	modified = false;
+	return true;
+}
+
+ColumnBlocks::ColumnBlocks(const ChunkColumn &col)
+:	key(col.getKey())
+{
+	for (int i = 0; i < ChunkColumn::NUM_SECTIONS; i++) {
+		sections[i] = col.getSection(i);
+	}
+}
+
+void ColumnBlocks::encode(std::vector<uchar> *out) const {
+	encodeSections(sections, out);
+}
+
+}
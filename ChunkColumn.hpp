@@ -0,0 +1,218 @@
+// ChunkColumn.hpp
+
+#ifndef CHUNK_COLUMN_HPP
+#define CHUNK_COLUMN_HPP
+
+#include <bitset>
+#include <cstddef>
+#include <vector>
+
+#include "BlockTypes.hpp"
+#include "ChunkSection.hpp"
+
+namespace as {
+
+typedef long long ChunkKey;
+
+/**
+ One EDGE x HEIGHT x EDGE column of the world, made of stacked sections.
+ Columns are the unit in which the terrain is generated, loaded, saved and evicted.
+*/
+class ChunkColumn {
+public:
+	enum Consts {
+		EDGE			= ChunkSection::EDGE,
+		HEIGHT			= WorldConfig::HEIGHT,
+		NUM_SECTIONS	= HEIGHT / EDGE,
+		NUM_BLOCKS		= EDGE * HEIGHT * EDGE,
+
+		// light levels are 4 bit, sky light in the high and block light in the low nibble
+		MAX_LIGHT		= 15,
+		SKY_LIGHT_SHIFT	= 4,
+		FULL_SKY_LIGHT	= MAX_LIGHT << SKY_LIGHT_SHIFT,
+
+		SOLID_WORD_BITS	= 64,
+		SOLID_WORDS		= (HEIGHT + SOLID_WORD_BITS - 1) / SOLID_WORD_BITS
+	};
+
+	// solid bits of a column of blocks, bit y % SOLID_WORD_BITS of word y / SOLID_WORD_BITS
+	typedef unsigned long long SolidWord;
+
+	// one bit per section, bottom first
+	typedef std::bitset<NUM_SECTIONS> SectionMask;
+
+	ChunkColumn(int cx, int cz);
+
+	DATA_TYPE get(int lx, int y, int lz) const;
+	void set(int lx, int y, int lz, DATA_TYPE val);
+
+	uchar getLight(int lx, int y, int lz) const;
+	void setLight(int lx, int y, int lz, uchar light);
+	// back to FULL_SKY_LIGHT everywhere
+	void clearLight();
+
+	// set for BlockType::SOLID blocks by set() and importBlocks(), Terrain clears it for open doors
+	bool isSolid(int lx, int y, int lz) const;
+	void setSolid(int lx, int y, int lz, bool solid);
+	const SolidWord *getSolidWords(int lx, int lz) const;
+
+	// summed-volume table of solid blocks filled by Terrain, (EDGE+1) x (HEIGHT+1) x (EDGE+1)
+	// prefix sums in x-major order, released by any change to the solid bits
+	std::vector<uint> &getSolidSums();
+	void invalidateSolidSums();
+
+	// bottom first
+	const ChunkSection &getSection(int s) const;
+
+	void compact();
+	size_t memoryUsage() const;
+
+	// dest/src use the flat x-major layout lx*(HEIGHT*EDGE)+y*EDGE+lz
+	void exportBlocks(DATA_TYPE *dest) const;
+	void importBlocks(const DATA_TYPE *src);
+
+	// LZ compressed blocks as stored in world files
+	void encode(std::vector<uchar> *out) const;
+	bool decode(const uchar *data, size_t size);
+
+	int getX() const;
+	int getZ() const;
+	ChunkKey getKey() const;
+
+	// height maps: y + 1 of the highest block casting a shadow / of the highest block at all, 0 if none
+	short &skyHeightAt(int lx, int lz);
+	short &topHeightAt(int lx, int lz);
+
+	static ChunkKey makeKey(int cx, int cz);
+	// sections whose faces a block at y touches: its own, plus the one it borders on
+	static SectionMask sectionsAround(int y);
+
+	// set whenever the column differs from its file on disk
+	bool modified;
+
+private:
+	ChunkSection sections[NUM_SECTIONS];
+	// per section in ChunkSection::localIndex() order, empty while all of it is FULL_SKY_LIGHT
+	std::vector<uchar> light[NUM_SECTIONS];
+	std::vector<uint> solidSums;
+	SolidWord solidBits[EDGE * EDGE][SOLID_WORDS];
+	short skyHeights[EDGE * EDGE];
+	short topHeights[EDGE * EDGE];
+	int cx, cz;
+};
+
+/**
+ Only the blocks of a column, which is all a save needs: copies share their
+ sections with the column and leave out everything derived from the blocks
+ (light, solid bits, height maps, ...).
+*/
+class ColumnBlocks {
+public:
+	explicit ColumnBlocks(const ChunkColumn &col);
+
+	ChunkKey getKey() const;
+	// see ChunkColumn::encode()
+	void encode(std::vector<uchar> *out) const;
+
+private:
+	ChunkKey key;
+	ChunkSection sections[ChunkColumn::NUM_SECTIONS];
+};
+
+struct ChunkKeyHash {
+	size_t operator()(ChunkKey key) const {
+		unsigned long long h = (unsigned long long)key * 0x9E3779B97F4A7C15ULL;
+		return (size_t)(h ^ (h >> 29));
+	}
+};
+
+//===========================================================================
+// Inlined implementations
+//===========================================================================
+inline ChunkKey ChunkColumn::makeKey(int cx, int cz) {
+	return ((ChunkKey)cx << 32) | (uint)cz;
+}
+
+inline const ChunkSection &ChunkColumn::getSection(int s) const {
+	return sections[s];
+}
+
+inline ChunkKey ColumnBlocks::getKey() const {
+	return key;
+}
+
+inline DATA_TYPE ChunkColumn::get(int lx, int y, int lz) const {
+	return sections[y >> ChunkSection::EDGE_SHIFT].get(ChunkSection::localIndex(lx, y & ChunkSection::EDGE_MASK, lz));
+}
+
+inline void ChunkColumn::set(int lx, int y, int lz, DATA_TYPE val) {
+	sections[y >> ChunkSection::EDGE_SHIFT].set(ChunkSection::localIndex(lx, y & ChunkSection::EDGE_MASK, lz), val);
+	setSolid(lx, y, lz, blockType(val).isSolid());
+	modified = true;
+}
+
+inline bool ChunkColumn::isSolid(int lx, int y, int lz) const {
+	return (solidBits[(lx << ChunkSection::EDGE_SHIFT) | lz][y / SOLID_WORD_BITS] >> (y % SOLID_WORD_BITS)) & 1;
+}
+
+inline void ChunkColumn::setSolid(int lx, int y, int lz, bool solid) {
+	SolidWord &word = solidBits[(lx << ChunkSection::EDGE_SHIFT) | lz][y / SOLID_WORD_BITS];
+	SolidWord bit = (SolidWord)1 << (y % SOLID_WORD_BITS);
+	word = solid ? (word | bit) : (word & ~bit);
+	invalidateSolidSums();
+}
+
+inline const ChunkColumn::SolidWord *ChunkColumn::getSolidWords(int lx, int lz) const {
+	return solidBits[(lx << ChunkSection::EDGE_SHIFT) | lz];
+}
+
+inline std::vector<uint> &ChunkColumn::getSolidSums() {
+	return solidSums;
+}
+
+// the table is several times the size of the blocks, it isn't kept around until the next query
+inline void ChunkColumn::invalidateSolidSums() {
+	if (!solidSums.empty())
+		std::vector<uint>().swap(solidSums);
+}
+
+inline uchar ChunkColumn::getLight(int lx, int y, int lz) const {
+	const std::vector<uchar> &l = light[y >> ChunkSection::EDGE_SHIFT];
+	return l.empty() ? (uchar)FULL_SKY_LIGHT : l[ChunkSection::localIndex(lx, y & ChunkSection::EDGE_MASK, lz)];
+}
+
+inline void ChunkColumn::setLight(int lx, int y, int lz, uchar val) {
+	std::vector<uchar> &l = light[y >> ChunkSection::EDGE_SHIFT];
+	if (l.empty()) {
+		if (val == FULL_SKY_LIGHT) return;
+		l.assign(ChunkSection::NUM_VOXELS, (uchar)FULL_SKY_LIGHT);
+	}
+	l[ChunkSection::localIndex(lx, y & ChunkSection::EDGE_MASK, lz)] = val;
+}
+
+inline ChunkColumn::SectionMask ChunkColumn::sectionsAround(int y) {
+	int s = y >> ChunkSection::EDGE_SHIFT, ly = y & ChunkSection::EDGE_MASK;
+	SectionMask mask;
+	mask.set(s);
+	if (ly == 0 && s > 0)
+		mask.set(s - 1);
+	else if (ly == EDGE - 1 && s + 1 < NUM_SECTIONS)
+		mask.set(s + 1);
+	return mask;
+}
+
+inline int ChunkColumn::getX() const { return cx; }
+inline int ChunkColumn::getZ() const { return cz; }
+inline ChunkKey ChunkColumn::getKey() const { return makeKey(cx, cz); }
+
+inline short &ChunkColumn::skyHeightAt(int lx, int lz) {
+	return skyHeights[(lx << ChunkSection::EDGE_SHIFT) | lz];
+}
+
+inline short &ChunkColumn::topHeightAt(int lx, int lz) {
+	return topHeights[(lx << ChunkSection::EDGE_SHIFT) | lz];
+}
+
+}
+
+#endif // CHUNK_COLUMN_HPP
@@ -0,0 +1,195 @@
+// ChunkSection.cpp
+
+
+
+#include <cstring>
+
+#include "ChunkSection.hpp"
+
+namespace as {
+
+static const uint zeroWord = 0;
+
+ChunkSection::ChunkSection(DATA_TYPE fillVal)
+:	wordMask(0),
+	valMask(0),
+	bitsShift(0),
+	wordShift(3 * EDGE_SHIFT),
+	bits(0),
+	uniformVal(fillVal)
+{
+	updateLookup();
+}
+
+ChunkSection::ChunkSection(const ChunkSection &other)
+:	wordMask(other.wordMask),
+	valMask(other.valMask),
+	bitsShift(other.bitsShift),
+	wordShift(other.wordShift),
+	bits(other.bits),
+	uniformVal(other.uniformVal),
+	data(other.data)
+{
+	updateLookup();
+}
+
+ChunkSection &ChunkSection::operator=(const ChunkSection &other) {
+	if (this != &other) {
+		data = other.data;
+		uniformVal = other.uniformVal;
+		bits = other.bits;
+		bitsShift = other.bitsShift;
+		wordShift = other.wordShift;
+		wordMask = other.wordMask;
+		valMask = other.valMask;
+		updateLookup();
+	}
+	return *this;
+}
+
+void ChunkSection::updateLookup() {
+	lookupPalette = bits ? &data->palette[0] : &uniformVal;
+	lookupIndices = bits ? &data->indices[0] : &zeroWord;
+}
+
+// unshare the storage before modifying it; copies only ever read theirs
+void ChunkSection::makeWritable() {
+	if (!data)
+		data = std::make_shared<Storage>();
+	else if (data.use_count() > 1)
+		data = std::make_shared<Storage>(*data);
+	else
+		return;
+	updateLookup();
+}
+
+int ChunkSection::paletteIndexOf(DATA_TYPE val) const {
+	const std::vector<DATA_TYPE> &palette = data->palette;
+	for (size_t i = 0; i < palette.size(); i++) {
+		if (palette[i] == val)
+			return (int)i;
+	}
+	return -1;
+}
+
+// repack all palette indices with newBits bits per index
+void ChunkSection::setBits(int newBits) {
+	std::vector<uint> newIndices;
+	int newBitsShift = 0, newWordShift = 0;
+	uint newWordMask = 0, newValMask = 0;
+
+	if (newBits) {
+		int perWord = 32 / newBits;
+		while ((1 << newBitsShift) < newBits)
+			newBitsShift++;
+		while ((1 << newWordShift) < perWord)
+			newWordShift++;
+		newWordMask = perWord - 1;
+		newValMask = (1u << newBits) - 1;
+
+		newIndices.assign(NUM_VOXELS >> newWordShift, 0);
+		if (bits) {
+			for (int i = 0; i < NUM_VOXELS; i++) {
+				newIndices[i >> newWordShift] |= readIndex(i) << ((i & newWordMask) << newBitsShift);
+			}
+		}
+	}
+
+	data->indices.swap(newIndices);
+	bits = (uchar)newBits;
+	bitsShift = (uchar)newBitsShift;
+	wordShift = (uchar)newWordShift;
+	wordMask = newWordMask;
+	valMask = newValMask;
+	updateLookup();
+}
+
+void ChunkSection::set(int index, DATA_TYPE val) {
+	if (!bits) {
+		if (val == uniformVal) return;
+		makeWritable();
+		data->palette.assign(1, uniformVal);
+		setBits(1);
+	} else {
+		if (get(index) == val) return;
+		makeWritable();
+	}
+
+	std::vector<DATA_TYPE> &palette = data->palette;
+	int pi = paletteIndexOf(val);
+	if (pi < 0) {
+		if (palette.size() == (1u << bits))
+			setBits(bits * 2);
+		pi = (int)palette.size();
+		palette.push_back(val);
+		updateLookup();
+	}
+
+	writeIndex(index, (uint)pi);
+}
+
+void ChunkSection::fill(DATA_TYPE val) {
+	data.reset();
+	uniformVal = val;
+	bits = bitsShift = 0;
+	wordShift = 3 * EDGE_SHIFT;
+	wordMask = valMask = 0;
+	updateLookup();
+}
+
+void ChunkSection::assign(const DATA_TYPE *vals) {
+	bool used[256];
+	uchar remap[256];
+	memset(used, 0, sizeof(used));
+
+	// never modify storage another copy might still read
+	if (data && data.use_count() > 1)
+		data.reset();
+	if (!data)
+		data = std::make_shared<Storage>();
+
+	std::vector<DATA_TYPE> &palette = data->palette;
+	palette.clear();
+	for (int i = 0; i < NUM_VOXELS; i++) {
+		if (!used[vals[i]]) {
+			used[vals[i]] = true;
+			remap[vals[i]] = (uchar)palette.size();
+			palette.push_back(vals[i]);
+		}
+	}
+
+	if (palette.size() == 1) {
+		fill(palette[0]);
+		return;
+	}
+
+	int newBits = 1;
+	while ((1u << newBits) < palette.size())
+		newBits *= 2;
+
+	bits = 0;
+	setBits(newBits);
+	for (int i = 0; i < NUM_VOXELS; i++) {
+		writeIndex(i, remap[vals[i]]);
+	}
+}
+
+// drop palette entries no longer referenced and shrink index width
+void ChunkSection::compact() {
+	if (!bits) return;
+
+	DATA_TYPE vals[NUM_VOXELS];
+	for (int i = 0; i < NUM_VOXELS; i++) {
+		vals[i] = get(i);
+	}
+	assign(vals);
+}
+
+size_t ChunkSection::memoryUsage() const {
+	if (!data)
+		return sizeof(ChunkSection);
+	return sizeof(ChunkSection) + sizeof(Storage)
+		+ data->palette.capacity() * sizeof(DATA_TYPE) + data->indices.capacity() * sizeof(uint);
+}
+
+}
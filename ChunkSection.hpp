@@ -0,0 +1,128 @@
+// ChunkSection.hpp
+
+#ifndef CHUNK_SECTION_HPP
+#define CHUNK_SECTION_HPP
+
+#include <memory>
+#include <vector>
+#include <cstddef>
+
+#include "Framework/Toggles.h"
+#include "WorldConfig.hpp"
+
+namespace as {
+
+typedef uchar DATA_TYPE;
+
+/**
+ Voxels of one cube of the terrain (16x16x16 in the default layout).
+ Stores a small palette of the distinct block values in the section plus
+ bit-packed (1, 2, 4 or 8 bit) palette indices. Sections consisting of only
+ one block type (all air, solid stone, ...) store no indices at all.
+ Copies share palette and indices until either side is modified, which makes
+ copying whole columns for snapshots cheap.
+*/
+class ChunkSection {
+public:
+	enum Consts {
+		EDGE		= WorldConfig::CHUNK_EDGE,
+		EDGE_SHIFT	= WorldConfig::CHUNK_SHIFT,
+		EDGE_MASK	= EDGE - 1,
+		NUM_VOXELS	= EDGE * EDGE * EDGE
+	};
+
+	explicit ChunkSection(DATA_TYPE fillVal = 0);
+	ChunkSection(const ChunkSection &other);
+	ChunkSection &operator=(const ChunkSection &other);
+
+	DATA_TYPE get(int index) const;
+	void set(int index, DATA_TYPE val);
+
+	void fill(DATA_TYPE val);
+	void assign(const DATA_TYPE *vals);
+	void compact();
+
+	bool isUniform() const;
+	DATA_TYPE getUniformValue() const;
+	size_t memoryUsage() const;
+
+	// position of a voxel in get()/set() order, see WorldConfig::VoxelLayout
+	static int localIndex(int lx, int ly, int lz);
+
+private:
+	// bit i of v to bit 3 * i
+	static int spreadBits(int v);
+
+	int paletteIndexOf(DATA_TYPE val) const;
+	void setBits(int newBits);
+	uint readIndex(int index) const;
+	void writeIndex(int index, uint pi);
+	void updateLookup();
+	void makeWritable();
+
+	// uniform sections point these at uniformVal and a zero word, so get() needs no branch
+	const DATA_TYPE *lookupPalette;
+	const uint *lookupIndices;
+	uint wordMask, valMask;
+	uchar bitsShift, wordShift;
+
+	// bits per palette index, 0 means uniform
+	uchar bits;
+	DATA_TYPE uniformVal;
+
+	struct Storage {
+		std::vector<DATA_TYPE> palette;
+		std::vector<uint> indices;
+	};
+
+	// NULL for uniform sections, shared between copies otherwise
+	std::shared_ptr<Storage> data;
+};
+
+//===========================================================================
+// Inlined implementations
+//===========================================================================
+inline int ChunkSection::spreadBits(int v) {
+	v = (v | (v << 16)) & 0x030000FF;
+	v = (v | (v << 8)) & 0x0300F00F;
+	v = (v | (v << 4)) & 0x030C30C3;
+	return (v | (v << 2)) & 0x09249249;
+}
+
+inline int ChunkSection::localIndex(int lx, int ly, int lz) {
+	if constexpr (WorldConfig::VOXEL_LAYOUT == WorldConfig::LAYOUT_MORTON) {
+		return (spreadBits(lx) << 2) | (spreadBits(ly) << 1) | spreadBits(lz);
+	} else if constexpr (WorldConfig::VOXEL_LAYOUT == WorldConfig::LAYOUT_BRICKS) {
+		const int B = WorldConfig::BRICK_SHIFT, BRICK_MASK = (1 << B) - 1;
+		int brick = ((lx >> B) << (2 * (EDGE_SHIFT - B))) | ((ly >> B) << (EDGE_SHIFT - B)) | (lz >> B);
+		return (brick << (3 * B)) | ((lx & BRICK_MASK) << (2 * B)) | ((ly & BRICK_MASK) << B) | (lz & BRICK_MASK);
+	} else {
+		return (lx << (2 * EDGE_SHIFT)) | (ly << EDGE_SHIFT) | lz;
+	}
+}
+
+inline uint ChunkSection::readIndex(int index) const {
+	return (lookupIndices[index >> wordShift] >> ((index & wordMask) << bitsShift)) & valMask;
+}
+
+inline void ChunkSection::writeIndex(int index, uint pi) {
+	uint &word = data->indices[index >> wordShift];
+	int shift = (index & wordMask) << bitsShift;
+	word = (word & ~(valMask << shift)) | (pi << shift);
+}
+
+inline DATA_TYPE ChunkSection::get(int index) const {
+	return lookupPalette[readIndex(index)];
+}
+
+inline bool ChunkSection::isUniform() const {
+	return !bits;
+}
+
+inline DATA_TYPE ChunkSection::getUniformValue() const {
+	return uniformVal;
+}
+
+}
+
+#endif // CHUNK_SECTION_HPP
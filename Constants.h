@@ -116,6 +116,8 @@ extern lang_t curLang;
 // Game mode
 //===========================================================================
 extern bool keepMeshes;
+// seconds between background saves of the world, 0 turns autosaving off
+extern int autosaveInterval;
 // MISC
 extern bool buyIntent;
 
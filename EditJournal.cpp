@@ -0,0 +1,158 @@
+// EditJournal.cpp
+
+
+
+#include "EditJournal.hpp"
+
+namespace as {
+
+EditJournal::EditJournal(size_t capacity)
+:	buffer(capacity),
+	head(0),
+	cursor(0),
+	used(0),
+	recording(false),
+	overflowed(false)
+{}
+
+void EditJournal::beginAction() {
+	if (recording) return;
+
+	while (actions.size() > cursor) {
+		used -= actions.back().size;
+		actions.pop_back();
+	}
+	if (used == 0)
+		head = 0;
+
+	pending.clear();
+	recording = true;
+	overflowed = false;
+	lastPos = BlockPos(0, 0, 0);
+}
+
+void EditJournal::endAction() {
+	if (!recording) return;
+	recording = false;
+
+	if (pending.empty() || overflowed)
+		return;
+
+	while (used + pending.size() > buffer.size()) {
+		head = (head + actions.front().size) % buffer.size();
+		used -= actions.front().size;
+		actions.pop_front();
+	}
+
+	Action action = { (head + used) % buffer.size(), pending.size() };
+	for (size_t i = 0; i < pending.size(); i++) {
+		buffer[(action.start + i) % buffer.size()] = pending[i];
+	}
+	used += pending.size();
+	actions.push_back(action);
+	cursor = actions.size();
+}
+
+void EditJournal::recordBlock(int x, int y, int z, DATA_TYPE oldVal, DATA_TYPE newVal) {
+	if (!recording) return;
+
+	put(BLOCK);
+	putPos(x, y, z);
+	put(oldVal);
+	put(newVal);
+}
+
+void EditJournal::recordEntity(RecordType type, const Entity &entity) {
+	if (!recording) return;
+
+	put((uchar)type);
+	putPos(entity.pos.x, entity.pos.y, entity.pos.z);
+	put((uchar)entity.type);
+	put((uchar)entity.cface);
+}
+
+bool EditJournal::undo(std::vector<Record> *records) {
+	if (!canUndo() || recording) return false;
+	decode(actions[--cursor], records);
+	return true;
+}
+
+bool EditJournal::redo(std::vector<Record> *records) {
+	if (!canRedo() || recording) return false;
+	decode(actions[cursor++], records);
+	return true;
+}
+
+void EditJournal::clear() {
+	actions.clear();
+	pending.clear();
+	head = cursor = used = 0;
+	recording = false;
+	overflowed = false;
+}
+
+// older actions are only dropped once the size of this one is known
+void EditJournal::put(uchar b) {
+	if (overflowed) return;
+
+	if (pending.size() == buffer.size()) {
+		overflowed = true;
+		pending.clear();
+		return;
+	}
+	pending.push_back(b);
+}
+
+// zigzag, so small negative numbers take one byte too
+void EditJournal::putVarint(int v) {
+	uint u = ((uint)v << 1) ^ (uint)(v >> 31);
+	while (u >= 0x80) {
+		put((uchar)(u | 0x80));
+		u >>= 7;
+	}
+	put((uchar)u);
+}
+
+void EditJournal::putPos(int x, int y, int z) {
+	putVarint(x - lastPos.x);
+	putVarint(y - lastPos.y);
+	putVarint(z - lastPos.z);
+	lastPos = BlockPos(x, y, z);
+}
+
+void EditJournal::decode(const Action &action, std::vector<Record> *records) const {
+	size_t offset = action.start, end = action.start + action.size;
+	BlockPos pos(0, 0, 0);
+
+	auto next = [&]() { return buffer[offset++ % buffer.size()]; };
+	auto nextVarint = [&]() {
+		uint u = 0;
+		for (int shift = 0; ; shift += 7) {
+			uchar b = next();
+			u |= (uint)(b & 0x7F) << shift;
+			if (!(b & 0x80)) break;
+		}
+		return (int)(u >> 1) ^ -(int)(u & 1);
+	};
+
+	records->clear();
+	while (offset < end) {
+		Record record;
+		record.type = (RecordType)next();
+		pos.x += nextVarint();
+		pos.y += nextVarint();
+		pos.z += nextVarint();
+		record.pos = pos;
+
+		if (record.type == BLOCK) {
+			record.oldVal = next();
+			record.newVal = next();
+		} else {
+			record.entityType = (Entity::EntityType)next();
+			record.cface = (CubeFace)next();
+		}
+		records->push_back(record);
+	}
+}
+
+}
@@ -0,0 +1,111 @@
+// EditJournal.hpp
+
+#ifndef EDIT_JOURNAL_HPP
+#define EDIT_JOURNAL_HPP
+
+#include <cstddef>
+#include <deque>
+#include <vector>
+
+#include "BlockPos.hpp"
+#include "ChunkSection.hpp"
+#include "VisibleFaces.hpp"
+#include "Entity.hpp"
+
+namespace as {
+
+/**
+ Undo/redo history of terrain edits, grouped into actions (see
+ Terrain::beginEdit()). Records are stored as bytes in a ring buffer of fixed
+ capacity, the oldest actions are dropped to make room. An action larger than
+ the whole buffer isn't kept, but doesn't drop the older ones either:
+
+	type		BLOCK, ENTITY_ADDED or ENTITY_REMOVED
+	position	x, y, z as zigzag varints relative to the previous record of the action
+	values		old and new block value, or entity type and face
+
+ A block record next to the previous one takes six bytes.
+*/
+class EditJournal {
+public:
+	enum Consts {
+		DEFAULT_CAPACITY = 1 << 20
+	};
+
+	enum RecordType {
+		BLOCK,
+		ENTITY_ADDED,
+		ENTITY_REMOVED
+	};
+
+	struct Record {
+		RecordType type;
+		BlockPos pos;
+		// BLOCK only
+		DATA_TYPE oldVal, newVal;
+		// ENTITY_* only
+		Entity::EntityType entityType;
+		CubeFace cface;
+	};
+
+	explicit EditJournal(size_t capacity = DEFAULT_CAPACITY);
+
+	// drops the actions which were undone, endAction() keeps the action unless it's empty or too large
+	void beginAction();
+	void endAction();
+	bool isRecording() const;
+
+	void recordBlock(int x, int y, int z, DATA_TYPE oldVal, DATA_TYPE newVal);
+	void recordEntity(RecordType type, const Entity &entity);
+
+	bool canUndo() const;
+	bool canRedo() const;
+	// the records of the action to undo or redo in recording order, false if there is none
+	bool undo(std::vector<Record> *records);
+	bool redo(std::vector<Record> *records);
+
+	void clear();
+	size_t getNumActions() const;
+	size_t getUsedBytes() const;
+
+private:
+	struct Action {
+		size_t start, size;
+	};
+
+	EditJournal(const EditJournal &);
+	EditJournal &operator=(const EditJournal &);
+
+	void put(uchar b);
+	void putVarint(int v);
+	void putPos(int x, int y, int z);
+	void decode(const Action &action, std::vector<Record> *records) const;
+
+	std::vector<uchar> buffer;
+	// records of the action being recorded, moved into the buffer by endAction()
+	std::vector<uchar> pending;
+	// start of the oldest action
+	size_t head;
+	std::deque<Action> actions;
+	// actions before it can be undone, the ones from it on redone
+	size_t cursor;
+	size_t used;
+
+	bool recording;
+	// the pending action is larger than the whole buffer
+	bool overflowed;
+	BlockPos lastPos;
+};
+
+//===========================================================================
+// Inlined implementations
+//===========================================================================
+inline bool EditJournal::isRecording() const { return recording; }
+inline bool EditJournal::canUndo() const { return cursor > 0; }
+inline bool EditJournal::canRedo() const { return cursor < actions.size(); }
+inline size_t EditJournal::getNumActions() const { return actions.size(); }
+inline size_t EditJournal::getUsedBytes() const { return used; }
+
+}
+
+#endif // EDIT_JOURNAL_HPP
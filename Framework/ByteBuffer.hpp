@@ -0,0 +1,126 @@
+// ByteBuffer.hpp
+
+#ifndef BYTE_BUFFER_HPP
+#define BYTE_BUFFER_HPP
+
+#include <cstring>
+#include <vector>
+
+#include "Toggles.h"
+
+namespace as {
+
+/**
+ Little endian serialisation independent of the host's byte order and struct layout.
+*/
+class ByteWriter {
+public:
+	explicit ByteWriter(std::vector<uchar> *_buf) : buf(_buf) {}
+
+	void putByte(uchar val) { buf->push_back(val); }
+
+	void putInt(int val) {
+		uint u = (uint)val;
+		for (int i = 0; i < 4; i++)
+			buf->push_back((uchar)(u >> (8 * i)));
+	}
+
+	void putFloat(float val) {
+		int i;
+		memcpy(&i, &val, sizeof(float));
+		putInt(i);
+	}
+
+	// 7 bits per byte, small values take a single byte
+	void putVarUInt(uint val) {
+		while (val >= 0x80) {
+			buf->push_back((uchar)(val | 0x80));
+			val >>= 7;
+		}
+		buf->push_back((uchar)val);
+	}
+
+	void putBytes(const void *data, size_t size) {
+		buf->insert(buf->end(), (const uchar *)data, (const uchar *)data + size);
+	}
+
+	// overwrite an int written earlier, e.g. an offset only known later
+	void patchInt(size_t pos, int val) {
+		uint u = (uint)val;
+		for (int i = 0; i < 4; i++)
+			(*buf)[pos + i] = (uchar)(u >> (8 * i));
+	}
+
+	size_t size() const { return buf->size(); }
+
+private:
+	std::vector<uchar> *buf;
+};
+
+/**
+ Counterpart of ByteWriter. Reading past the end yields zeros and clears ok().
+*/
+class ByteReader {
+public:
+	ByteReader(const uchar *_data, size_t _size) : data(_data), size(_size), pos(0), valid(true) {}
+
+	uchar getByte() {
+		if (!require(1)) return 0;
+		return data[pos++];
+	}
+
+	int getInt() {
+		if (!require(4)) return 0;
+		uint u = 0;
+		for (int i = 0; i < 4; i++)
+			u |= (uint)data[pos++] << (8 * i);
+		return (int)u;
+	}
+
+	float getFloat() {
+		int i = getInt();
+		float val;
+		memcpy(&val, &i, sizeof(float));
+		return val;
+	}
+
+	uint getVarUInt() {
+		uint val = 0;
+		for (int shift = 0; shift < 32; shift += 7) {
+			uchar b = getByte();
+			val |= (uint)(b & 0x7F) << shift;
+			if (!(b & 0x80)) break;
+		}
+		return val;
+	}
+
+	void getBytes(void *dest, size_t n) {
+		if (!require(n)) {
+			memset(dest, 0, n);
+			return;
+		}
+		memcpy(dest, data + pos, n);
+		pos += n;
+	}
+
+	bool atEnd() const { return pos >= size; }
+	bool ok() const { return valid; }
+
+private:
+	bool require(size_t n) {
+		if (size - pos < n) {
+			valid = false;
+			pos = size;
+			return false;
+		}
+		return true;
+	}
+
+	const uchar *data;
+	size_t size, pos;
+	bool valid;
+};
+
+}
+
+#endif // BYTE_BUFFER_HPP
@@ -0,0 +1,96 @@
+// Compression.cpp
+
+
+
+#include "ByteBuffer.hpp"
+#include "Compression.hpp"
+
+namespace as {
+
+enum CompressionConsts {
+	MIN_MATCH = 3,
+	HASH_BITS = 12,
+	MAX_CHAIN = 16
+};
+
+inline uint hash3(const uchar *p) {
+	return ((p[0] << 16 | p[1] << 8 | p[2]) * 2654435761u) >> (32 - HASH_BITS);
+}
+
+void compressLZ(const uchar *src, size_t size, std::vector<uchar> *out) {
+	ByteWriter w(out);
+
+	// most recent position per hash and the previous position with the same hash
+	std::vector<int> head(1 << HASH_BITS, -1);
+	std::vector<int> prev(size);
+
+	size_t pos = 0, literals = 0;
+
+	while (pos < size) {
+		size_t bestLen = 0, bestOffset = 0;
+
+		if (pos + MIN_MATCH <= size) {
+			uint h = hash3(&src[pos]);
+			int cand = head[h];
+			for (int chain = 0; cand >= 0 && chain < MAX_CHAIN; chain++) {
+				size_t len = 0;
+				while (pos + len < size && src[cand + len] == src[pos + len])
+					len++;
+				if (len > bestLen) {
+					bestLen = len;
+					bestOffset = pos - cand;
+				}
+				cand = prev[cand];
+			}
+		}
+
+		size_t advance = bestLen >= MIN_MATCH ? bestLen : 1;
+		for (size_t i = 0; i < advance && pos + i + MIN_MATCH <= size; i++) {
+			uint h = hash3(&src[pos + i]);
+			prev[pos + i] = head[h];
+			head[h] = (int)(pos + i);
+		}
+
+		if (bestLen >= MIN_MATCH) {
+			w.putVarUInt((uint)literals);
+			w.putBytes(&src[pos - literals], literals);
+			w.putVarUInt((uint)(bestLen - MIN_MATCH));
+			w.putVarUInt((uint)bestOffset);
+			literals = 0;
+		} else {
+			literals++;
+		}
+		pos += advance;
+	}
+
+	// always ends with literals, possibly none
+	w.putVarUInt((uint)literals);
+	w.putBytes(&src[pos - literals], literals);
+}
+
+bool decompressLZ(const uchar *src, size_t size, uchar *dest, size_t destSize) {
+	ByteReader r(src, size);
+	size_t pos = 0;
+
+	for (;;) {
+		uint literals = r.getVarUInt();
+		if (!r.ok() || literals > destSize - pos)
+			return false;
+		r.getBytes(&dest[pos], literals);
+		pos += literals;
+
+		if (pos == destSize)
+			return r.ok() && r.atEnd();
+
+		size_t len = r.getVarUInt() + MIN_MATCH;
+		size_t offset = r.getVarUInt();
+		if (!r.ok() || offset == 0 || offset > pos || len > destSize - pos)
+			return false;
+
+		for (size_t i = 0; i < len; i++, pos++) {
+			dest[pos] = dest[pos - offset];
+		}
+	}
+}
+
+}
@@ -0,0 +1,25 @@
+// Compression.hpp
+
+#ifndef COMPRESSION_HPP
+#define COMPRESSION_HPP
+
+#include <cstddef>
+#include <vector>
+
+#include "Toggles.h"
+
+namespace as {
+
+/**
+ Small LZ77 style codec for world data. The output is a sequence of
+ (literal count, literals, match length, match offset) tokens with varint
+ numbers; matches may overlap their source, so runs cost a single token.
+*/
+void compressLZ(const uchar *src, size_t size, std::vector<uchar> *out);
+
+// fails on damaged input or if it doesn't decode to exactly destSize bytes
+bool decompressLZ(const uchar *src, size_t size, uchar *dest, size_t destSize);
+
+}
+
+#endif // COMPRESSION_HPP
@@ -2,6 +2,12 @@
 
 
 
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE4_1__)
+#include <smmintrin.h>
+#endif
+
 #include "Noise.hpp"
 
 namespace as {
@@ -21,4 +27,198 @@ float noise(float x, float y, int rval) {
 	return trigInterp(a, b, y - floorY);
 }
 
+//===========================================================================
+// Batch evaluation
+//===========================================================================
+namespace {
+
+const int HASH_MUL = 60493;
+const int HASH_ADD = 1376312589;
+const float HASH_SCALE = 1.0f / 1073741824.0f;
+
+// (1 - cos(PI * x)) / 2 as an odd polynomial around x = 0.5, error < 2e-6
+const float FADE_C1 = 1.57079633f;
+const float FADE_C3 = -2.58385639f;
+const float FADE_C5 = 1.27508202f;
+const float FADE_C7 = -0.299632265f;
+const float FADE_C9 = 0.0410729433f;
+
+// noiseFunc() for integer coordinates, k = rval % 90303 + 199000
+inline float hashNoise(int n, int k) {
+	n = (n << 13) ^ n;
+	// unsigned to wrap around like the vector code
+	unsigned int un = (unsigned int)n;
+	int nn = (int)((un * (un * un * HASH_MUL + k) + HASH_ADD) & 0x7fffffff);
+	return 1.0f - (float)nn * HASH_SCALE;
+}
+
+inline float fade(float x) {
+	float u = x - 0.5f, u2 = u * u;
+	return 0.5f + u * (FADE_C1 + u2 * (FADE_C3 + u2 * (FADE_C5 + u2 * (FADE_C7 + u2 * FADE_C9))));
+}
+
+inline float fadeInterp(float a, float b, float x) {
+	float f = fade(x);
+	return a * (1.0f - f) + b * f;
+}
+
+inline float noisePoint(float x, float y, int k) {
+	int ix = (int)x, iy = (int)y;
+	int n = ix + iy * 57;
+	float fx = x - (float)ix, fy = y - (float)iy;
+
+	float a = fadeInterp(hashNoise(n, k), hashNoise(n + 1, k), fx);
+	float b = fadeInterp(hashNoise(n + 57, k), hashNoise(n + 58, k), fx);
+	return fadeInterp(a, b, fy);
+}
+
+inline float noise3Point(float x, float y, float z, int k) {
+	int ix = (int)x, iy = (int)y, iz = (int)z;
+	int n = ix + iy * 57 + iz * 113;
+	float fx = x - (float)ix, fy = y - (float)iy, fz = z - (float)iz;
+
+	float a = fadeInterp(hashNoise(n, k), hashNoise(n + 1, k), fx);
+	float b = fadeInterp(hashNoise(n + 57, k), hashNoise(n + 58, k), fx);
+	float c = fadeInterp(hashNoise(n + 113, k), hashNoise(n + 114, k), fx);
+	float d = fadeInterp(hashNoise(n + 170, k), hashNoise(n + 171, k), fx);
+	return fadeInterp(fadeInterp(a, b, fy), fadeInterp(c, d, fy), fz);
+}
+
+#if defined(__AVX2__)
+const int LANES = 8;
+
+inline __m256 hashNoise(__m256i n, __m256i k) {
+	n = _mm256_xor_si256(_mm256_slli_epi32(n, 13), n);
+	__m256i t = _mm256_add_epi32(_mm256_mullo_epi32(_mm256_mullo_epi32(n, n), _mm256_set1_epi32(HASH_MUL)), k);
+	t = _mm256_add_epi32(_mm256_mullo_epi32(n, t), _mm256_set1_epi32(HASH_ADD));
+	t = _mm256_and_si256(t, _mm256_set1_epi32(0x7fffffff));
+	return _mm256_sub_ps(_mm256_set1_ps(1.0f), _mm256_mul_ps(_mm256_cvtepi32_ps(t), _mm256_set1_ps(HASH_SCALE)));
+}
+
+inline __m256 fadeInterp(__m256 a, __m256 b, __m256 x) {
+	__m256 u = _mm256_sub_ps(x, _mm256_set1_ps(0.5f)), u2 = _mm256_mul_ps(u, u);
+	__m256 p = _mm256_add_ps(_mm256_set1_ps(FADE_C7), _mm256_mul_ps(u2, _mm256_set1_ps(FADE_C9)));
+	p = _mm256_add_ps(_mm256_set1_ps(FADE_C5), _mm256_mul_ps(u2, p));
+	p = _mm256_add_ps(_mm256_set1_ps(FADE_C3), _mm256_mul_ps(u2, p));
+	p = _mm256_add_ps(_mm256_set1_ps(FADE_C1), _mm256_mul_ps(u2, p));
+	__m256 f = _mm256_add_ps(_mm256_set1_ps(0.5f), _mm256_mul_ps(u, p));
+	return _mm256_add_ps(_mm256_mul_ps(a, _mm256_sub_ps(_mm256_set1_ps(1.0f), f)), _mm256_mul_ps(b, f));
+}
+
+inline void noiseLanes(const float *x, const float *y, int k, float *out) {
+	__m256 vx = _mm256_loadu_ps(x), vy = _mm256_loadu_ps(y);
+	__m256i ix = _mm256_cvttps_epi32(vx), iy = _mm256_cvttps_epi32(vy);
+	__m256i n = _mm256_add_epi32(ix, _mm256_mullo_epi32(iy, _mm256_set1_epi32(57)));
+	__m256i vk = _mm256_set1_epi32(k);
+	__m256 fx = _mm256_sub_ps(vx, _mm256_cvtepi32_ps(ix));
+	__m256 fy = _mm256_sub_ps(vy, _mm256_cvtepi32_ps(iy));
+
+	__m256 a = fadeInterp(hashNoise(n, vk), hashNoise(_mm256_add_epi32(n, _mm256_set1_epi32(1)), vk), fx);
+	__m256 b = fadeInterp(hashNoise(_mm256_add_epi32(n, _mm256_set1_epi32(57)), vk),
+		hashNoise(_mm256_add_epi32(n, _mm256_set1_epi32(58)), vk), fx);
+	_mm256_storeu_ps(out, fadeInterp(a, b, fy));
+}
+#elif defined(__SSE4_1__)
+const int LANES = 4;
+
+inline __m128 hashNoise(__m128i n, __m128i k) {
+	n = _mm_xor_si128(_mm_slli_epi32(n, 13), n);
+	__m128i t = _mm_add_epi32(_mm_mullo_epi32(_mm_mullo_epi32(n, n), _mm_set1_epi32(HASH_MUL)), k);
+	t = _mm_add_epi32(_mm_mullo_epi32(n, t), _mm_set1_epi32(HASH_ADD));
+	t = _mm_and_si128(t, _mm_set1_epi32(0x7fffffff));
+	return _mm_sub_ps(_mm_set1_ps(1.0f), _mm_mul_ps(_mm_cvtepi32_ps(t), _mm_set1_ps(HASH_SCALE)));
+}
+
+inline __m128 fadeInterp(__m128 a, __m128 b, __m128 x) {
+	__m128 u = _mm_sub_ps(x, _mm_set1_ps(0.5f)), u2 = _mm_mul_ps(u, u);
+	__m128 p = _mm_add_ps(_mm_set1_ps(FADE_C7), _mm_mul_ps(u2, _mm_set1_ps(FADE_C9)));
+	p = _mm_add_ps(_mm_set1_ps(FADE_C5), _mm_mul_ps(u2, p));
+	p = _mm_add_ps(_mm_set1_ps(FADE_C3), _mm_mul_ps(u2, p));
+	p = _mm_add_ps(_mm_set1_ps(FADE_C1), _mm_mul_ps(u2, p));
+	__m128 f = _mm_add_ps(_mm_set1_ps(0.5f), _mm_mul_ps(u, p));
+	return _mm_add_ps(_mm_mul_ps(a, _mm_sub_ps(_mm_set1_ps(1.0f), f)), _mm_mul_ps(b, f));
+}
+
+inline void noiseLanes(const float *x, const float *y, int k, float *out) {
+	__m128 vx = _mm_loadu_ps(x), vy = _mm_loadu_ps(y);
+	__m128i ix = _mm_cvttps_epi32(vx), iy = _mm_cvttps_epi32(vy);
+	__m128i n = _mm_add_epi32(ix, _mm_mullo_epi32(iy, _mm_set1_epi32(57)));
+	__m128i vk = _mm_set1_epi32(k);
+	__m128 fx = _mm_sub_ps(vx, _mm_cvtepi32_ps(ix));
+	__m128 fy = _mm_sub_ps(vy, _mm_cvtepi32_ps(iy));
+
+	__m128 a = fadeInterp(hashNoise(n, vk), hashNoise(_mm_add_epi32(n, _mm_set1_epi32(1)), vk), fx);
+	__m128 b = fadeInterp(hashNoise(_mm_add_epi32(n, _mm_set1_epi32(57)), vk),
+		hashNoise(_mm_add_epi32(n, _mm_set1_epi32(58)), vk), fx);
+	_mm_storeu_ps(out, fadeInterp(a, b, fy));
+}
+#else
+const int LANES = 1;
+
+inline void noiseLanes(const float *x, const float *y, int k, float *out) {
+	*out = noisePoint(*x, *y, k);
+}
+#endif
+
+} // namespace
+
+void noiseBatch(const float *x, const float *y, int count, int rval, float *out) {
+	int k = rval % 90303 + 199000;
+	int i = 0;
+
+	for (; i + LANES <= count; i += LANES) {
+		noiseLanes(x + i, y + i, k, out + i);
+	}
+	for (; i < count; i++) {
+		out[i] = noisePoint(x[i], y[i], k);
+	}
+}
+
+float noise3(float x, float y, float z, int rval) {
+	return noise3Point(x, y, z, rval % 90303 + 199000);
+}
+
+void noise3Grid(int x0, int y0, int z0, int step, int nx, int ny, int nz, float zoom, int rval, float *out) {
+	int k = rval % 90303 + 199000;
+
+	for (int i = 0; i < nx; i++) {
+		float x = (float)(x0 + i * step) / zoom;
+		for (int j = 0; j < ny; j++) {
+			float y = (float)(y0 + j * step) / zoom;
+			for (int l = 0; l < nz; l++) {
+				*out++ = noise3Point(x, y, (float)(z0 + l * step) / zoom, k);
+			}
+		}
+	}
+}
+
+bool checkNoiseBatch() {
+	enum { NUM_SAMPLES = 1000 };
+	const int rvals[] = { 0, 12345, 1 << 30, 2147483647 };
+	float x[NUM_SAMPLES], y[NUM_SAMPLES], out[NUM_SAMPLES];
+
+	for (int i = 0; i < NUM_SAMPLES; i++) {
+		// fractions all over [0, 1) and cell coordinates up to the world size
+		x[i] = (float)(i * 7919 % 8192) + (float)i / NUM_SAMPLES;
+		y[i] = (float)(i * 104729 % 8192) + (float)(NUM_SAMPLES - i) / NUM_SAMPLES;
+	}
+
+	for (size_t r = 0; r < sizeof(rvals) / sizeof(rvals[0]); r++) {
+		// odd count to run the scalar tail too
+		noiseBatch(x, y, NUM_SAMPLES - 1, rvals[r], out);
+
+		for (int i = 0; i < NUM_SAMPLES - 1; i++) {
+			if (std::fabs(out[i] - noise(x[i], y[i], rvals[r])) > NOISE_BATCH_TOLERANCE)
+				return false;
+
+			float single;
+			noiseBatch(&x[i], &y[i], 1, rvals[r], &single);
+			if (single != out[i])
+				return false;
+		}
+	}
+
+	return true;
+}
+
 } // namespace as
@@ -11,6 +11,29 @@ namespace as {
 
 float noise(float x, float y, int rval);
 
+/**
+ out[i] = noise(x[i], y[i], rval) for count points at once, for x, y >= 0.
+ Uses SSE4.1 or AVX2 if the compiler targets them, and interpolates with a
+ polynomial instead of cosf. The result differs from noise() by less than
+ NOISE_BATCH_TOLERANCE, but doesn't depend on the batch: vector lanes and
+ single points do the same operations in the same order (Noise.cpp is built
+ without contracting them into fused multiply-adds).
+*/
+void noiseBatch(const float *x, const float *y, int count, int rval, float *out);
+// compares noiseBatch() with noise() and with itself on single points, see runBenchmark()
+bool checkNoiseBatch();
+
+const float NOISE_BATCH_TOLERANCE = 1e-5f;
+
+// value noise in 3D for x, y, z >= 0, interpolated like noiseBatch()
+float noise3(float x, float y, float z, int rval);
+/**
+ noise3() on a nx x ny x nz grid of integer points step apart, starting at
+ x0, y0, z0 and scaled by 1 / zoom: out[(i * ny + j) * nz + k] for point
+ i, j, k. A point gets the same value whichever grid it is part of.
+*/
+void noise3Grid(int x0, int y0, int z0, int step, int nx, int ny, int nz, float zoom, int rval, float *out);
+
 inline float noiseFunc(float x, float y, int rval) {
 	int n = (int)x + (int)y * 57;
 	n = (n << 13) ^ n;
@@ -0,0 +1,66 @@
+// Random.hpp
+
+#ifndef RANDOM_HPP
+#define RANDOM_HPP
+
+namespace as {
+
+/**
+ Small seedable random number generator (xorshift64*). Unlike rand() every
+ instance has its own state, so e.g. each terrain column can draw from a
+ generator derived from its coordinates, independent of generation order
+ and thread.
+*/
+class Random {
+public:
+	explicit Random(unsigned long long seed);
+
+	// uniformly distributed in [0, 2^31)
+	int next();
+	// [0, n) for n > 0
+	int nextInt(int n);
+
+	// well mixed seed for a generator of one grid cell, e.g. a column
+	static unsigned long long cellSeed(int seed, int x, int z);
+
+private:
+	static unsigned long long mix(unsigned long long h);
+
+	unsigned long long state;
+};
+
+//===========================================================================
+// Inlined implementations
+//===========================================================================
+// splitmix64 finalizer
+inline unsigned long long Random::mix(unsigned long long h) {
+	h ^= h >> 30;
+	h *= 0xBF58476D1CE4E5B9ULL;
+	h ^= h >> 27;
+	h *= 0x94D049BB133111EBULL;
+	return h ^ (h >> 31);
+}
+
+// xorshift gets stuck at 0
+inline Random::Random(unsigned long long seed) : state(mix(seed) | 1) {}
+
+inline int Random::next() {
+	state ^= state >> 12;
+	state ^= state << 25;
+	state ^= state >> 27;
+	return (int)((state * 0x2545F4914F6CDD1DULL) >> 33);
+}
+
+inline int Random::nextInt(int n) {
+	return next() % n;
+}
+
+inline unsigned long long Random::cellSeed(int seed, int x, int z) {
+	unsigned long long h = mix((unsigned long long)(unsigned int)seed + 0x9E3779B97F4A7C15ULL);
+	h = mix(h ^ (unsigned int)x);
+	return mix(h ^ ((unsigned long long)(unsigned int)z << 32));
+}
+
+}
+
+#endif // RANDOM_HPP
@@ -68,10 +68,20 @@ extern void Droid_BinaryWrite(const char *filename, const void *data, size_t siz
 #define binaryWrite Droid_BinaryWrite
 extern void Droid_BinaryRead(const char *filename, void *data, size_t size);
 #define binaryRead Droid_BinaryRead
+extern void Droid_BinaryWriteAt(const char *filename, size_t offset, const void *data, size_t size);
+#define binaryWriteAt Droid_BinaryWriteAt
+extern void Droid_BinaryReadAt(const char *filename, size_t offset, void *data, size_t size);
+#define binaryReadAt Droid_BinaryReadAt
+extern const void *Droid_MapFile(const char *filename, size_t *size);
+#define mapFile Droid_MapFile
+extern void Droid_UnmapFile(const void *data, size_t size);
+#define unmapFile Droid_UnmapFile
 extern bool Droid_FileExists(const char *filename);
 #define fileExists Droid_FileExists
 extern void Droid_DeleteFile(const char *filename);
 #define deleteFile Droid_DeleteFile
+extern void Droid_RenameFile(const char *from, const char *to);
+#define renameFile Droid_RenameFile
 extern void Droid_ToggleTexture(int classic);
 #define toggleTexture Droid_ToggleTexture
 #elif IPHONE
@@ -87,10 +97,20 @@ extern void IOS_BinaryWrite(const char *filename, const void *data, size_t size,
 #define binaryWrite IOS_BinaryWrite
 extern void IOS_BinaryRead(const char *filename, void *data, size_t size);
 #define binaryRead IOS_BinaryRead
+extern void IOS_BinaryWriteAt(const char *filename, size_t offset, const void *data, size_t size);
+#define binaryWriteAt IOS_BinaryWriteAt
+extern void IOS_BinaryReadAt(const char *filename, size_t offset, void *data, size_t size);
+#define binaryReadAt IOS_BinaryReadAt
+extern const void *IOS_MapFile(const char *filename, size_t *size);
+#define mapFile IOS_MapFile
+extern void IOS_UnmapFile(const void *data, size_t size);
+#define unmapFile IOS_UnmapFile
 extern bool IOS_FileExists(const char *filename, bool trySuffix = true);
 #define fileExists IOS_FileExists
 extern void IOS_DeleteFile(const char *filename);
 #define deleteFile IOS_DeleteFile
+extern void IOS_RenameFile(const char *from, const char *to);
+#define renameFile IOS_RenameFile
 extern void IOS_ToggleTexture(int classic);
 #define toggleTexture IOS_ToggleTexture
 #endif
@@ -103,8 +123,13 @@ extern void SDL_PlaySound(int sndId);
 extern void SDL_StopSound(int sndId);
 extern void SDL_BinaryWrite(const char *filename, const void *data, size_t size, bool append = false);
 extern void SDL_BinaryRead(const char *filename, void *data, size_t size);
+extern void SDL_BinaryWriteAt(const char *filename, size_t offset, const void *data, size_t size);
+extern void SDL_BinaryReadAt(const char *filename, size_t offset, void *data, size_t size);
+extern const void *SDL_MapFile(const char *filename, size_t *size);
+extern void SDL_UnmapFile(const void *data, size_t size);
 extern bool SDL_FileExists(const char *filename);
 extern void SDL_DeleteFile(const char *filename);
+extern void SDL_RenameFile(const char *from, const char *to);
 extern void SDL_ToggleTexture(int texMapIndex);
 }
 
@@ -114,8 +139,13 @@ extern void SDL_ToggleTexture(int texMapIndex);
 #define stopSound SDL_StopSound
 #define binaryWrite SDL_BinaryWrite
 #define binaryRead SDL_BinaryRead
+#define binaryWriteAt SDL_BinaryWriteAt
+#define binaryReadAt SDL_BinaryReadAt
+#define mapFile SDL_MapFile
+#define unmapFile SDL_UnmapFile
 #define fileExists SDL_FileExists
 #define deleteFile SDL_DeleteFile
+#define renameFile SDL_RenameFile
 #define toggleTexture SDL_ToggleTexture
 
 #elif MAC
@@ -132,10 +162,20 @@ extern void OSX_BinaryWrite(const char *filename, const void *data, size_t size,
 #define binaryWrite OSX_BinaryWrite
 extern void OSX_BinaryRead(const char *filename, void *data, size_t size);
 #define binaryRead OSX_BinaryRead
+extern void OSX_BinaryWriteAt(const char *filename, size_t offset, const void *data, size_t size);
+#define binaryWriteAt OSX_BinaryWriteAt
+extern void OSX_BinaryReadAt(const char *filename, size_t offset, void *data, size_t size);
+#define binaryReadAt OSX_BinaryReadAt
+extern const void *OSX_MapFile(const char *filename, size_t *size);
+#define mapFile OSX_MapFile
+extern void OSX_UnmapFile(const void *data, size_t size);
+#define unmapFile OSX_UnmapFile
 extern bool OSX_FileExists(const char *filename);
 #define fileExists OSX_FileExists
 extern void OSX_DeleteFile(const char *filename);
 #define deleteFile OSX_DeleteFile
+extern void OSX_RenameFile(const char *from, const char *to);
+#define renameFile OSX_RenameFile
 extern void OSX_GetMousePos(int *x, int *y);
 extern void OSX_ToggleTexture(int classic);
 #define toggleTexture OSX_ToggleTexture
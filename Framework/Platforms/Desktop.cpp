@@ -14,6 +14,16 @@
 #include <cstring>
 #include <fstream>
 
+#if WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 #include "../State.hpp"
 #include "../Utilities.hpp"
 
@@ -161,6 +171,12 @@ void LibSdl::processInput( ticks_t delta )
 	CONV_KCODES(SDLK_BACKSPACE, KEY_BACKSPACE);
 	CONV_KCODES(SDLK_RETURN, KEY_RETURN);
 	CONV_KCODES(SDLK_SPACE, KEY_SPACE);
+	CONV_KCODES(SDLK_z, KEY_Z);
+	CONV_KCODES(SDLK_y, KEY_Y);
+	CONV_KCODES(SDLK_LCTRL, KEY_CTRL);
+	CONV_KCODES(SDLK_RCTRL, KEY_CTRL);
+	CONV_KCODES(SDLK_LMETA, KEY_CMD);
+	CONV_KCODES(SDLK_RMETA, KEY_CMD);
 
 	StateManager::getInstance()->getState()->processKeyboardInput(convKeys, SDL_GetModState(), delta);
 
@@ -252,6 +268,64 @@ void SDL_BinaryRead(const char *filename, void *data, size_t size) {
 	ifs.read((char *)data, size);
 }
 
+// in place, creating the file if needed
+void SDL_BinaryWriteAt(const char *filename, size_t offset, const void *data, size_t size) {
+	if(!std::filesystem::exists(filename))
+		std::ofstream{filename, std::ios::binary};
+	std::fstream fs{filename, std::ios::binary | std::ios::in | std::ios::out};
+	fs.seekp(offset);
+	fs.write((const char *)data, size);
+}
+
+void SDL_BinaryReadAt(const char *filename, size_t offset, void *data, size_t size) {
+	std::ifstream ifs{filename, std::ios::binary};
+	ifs.seekg(offset);
+	ifs.read((char *)data, size);
+}
+
+// read only, NULL if the file is missing or empty
+const void *SDL_MapFile(const char *filename, size_t *size) {
+#if WIN32
+	HANDLE file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+							  NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if(file == INVALID_HANDLE_VALUE) return NULL;
+
+	LARGE_INTEGER fileSize;
+	const void *data = NULL;
+	if(GetFileSizeEx(file, &fileSize) && fileSize.QuadPart > 0) {
+		HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+		if(mapping) {
+			data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+			*size = (size_t)fileSize.QuadPart;
+			CloseHandle(mapping);
+		}
+	}
+	CloseHandle(file);
+	return data;
+#else
+	int fd = open(filename, O_RDONLY);
+	if(fd < 0) return NULL;
+
+	struct stat st;
+	void *data = NULL;
+	if(fstat(fd, &st) == 0 && st.st_size > 0) {
+		data = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+		if(data == MAP_FAILED) data = NULL;
+		*size = st.st_size;
+	}
+	close(fd);
+	return data;
+#endif
+}
+
+void SDL_UnmapFile(const void *data, size_t size) {
+#if WIN32
+	UnmapViewOfFile(data);
+#else
+	munmap((void *)data, size);
+#endif
+}
+
 bool SDL_FileExists(const char *filename) {
 	//return Poco::File(std::string(filename) + ".gz").exists();
 	return std::filesystem::exists(filename);
@@ -262,6 +336,11 @@ void SDL_DeleteFile(const char *filename) {
 	f.remove();*/
 	std::filesystem::remove(filename);
 }
+
+// replaces an existing file of the new name
+void SDL_RenameFile(const char *from, const char *to) {
+	std::filesystem::rename(from, to);
+}
 	
 void SDL_ToggleTexture(int texMapIndex) {
 	SAFE_DELETE(texMap);
@@ -19,10 +19,22 @@ typedef enum keys_s {
 	KEY_F,
 	KEY_BACKSPACE,
 	KEY_RETURN,
-	KEY_SPACE
+	KEY_SPACE,
+	KEY_Z,
+	KEY_Y,
+	// modifiers, left or right
+	KEY_CTRL,
+	KEY_CMD
 } key_t;
 
-const int NUM_KEYS = KEY_SPACE + 1;
+const int NUM_KEYS = KEY_CMD + 1;
+
+// held together with the key of a shortcut like undo
+#ifdef __APPLE__
+const key_t KEY_SHORTCUT = KEY_CMD;
+#else
+const key_t KEY_SHORTCUT = KEY_CTRL;
+#endif
 
 #if SDL
 class LibSdl {
@@ -0,0 +1,86 @@
+// ThreadPool.cpp
+
+
+
+#include "ThreadPool.hpp"
+
+namespace as {
+
+ThreadPool::ThreadPool(int numThreads)
+:	job(NULL),
+	count(0),
+	next(0),
+	busyWorkers(0),
+	generation(0),
+	quit(false)
+{
+	if (numThreads <= 0)
+		numThreads = (int)std::thread::hardware_concurrency();
+
+	for (int i = 1; i < numThreads; i++) {
+		workers.push_back(std::thread(&ThreadPool::workerLoop, this));
+	}
+}
+
+ThreadPool::~ThreadPool() {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		quit = true;
+	}
+	wake.notify_all();
+
+	for (size_t i = 0; i < workers.size(); i++) {
+		workers[i].join();
+	}
+}
+
+void ThreadPool::parallelFor(int _count, const std::function<void(int)> &_job) {
+	if (workers.empty() || _count <= 1) {
+		for (int i = 0; i < _count; i++) {
+			_job(i);
+		}
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		job = &_job;
+		count = _count;
+		next = 0;
+		busyWorkers = (int)workers.size();
+		generation++;
+	}
+	wake.notify_all();
+
+	runJob();
+
+	std::unique_lock<std::mutex> lock(mutex);
+	done.wait(lock, [this] { return busyWorkers == 0; });
+	job = NULL;
+}
+
+void ThreadPool::runJob() {
+	for (int i = next++; i < count; i = next++) {
+		(*job)(i);
+	}
+}
+
+void ThreadPool::workerLoop() {
+	unsigned int seen = 0;
+	std::unique_lock<std::mutex> lock(mutex);
+
+	for (;;) {
+		wake.wait(lock, [&] { return quit || generation != seen; });
+		if (quit) return;
+		seen = generation;
+
+		lock.unlock();
+		runJob();
+		lock.lock();
+
+		if (--busyWorkers == 0)
+			done.notify_one();
+	}
+}
+
+}
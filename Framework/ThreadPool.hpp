@@ -0,0 +1,57 @@
+// ThreadPool.hpp
+
+#ifndef THREAD_POOL_HPP
+#define THREAD_POOL_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace as {
+
+/**
+ Fixed set of worker threads for data parallel jobs. parallelFor() blocks
+ until the job ran for all indices and works on them on the calling thread
+ too. Only one thread may hand out jobs.
+*/
+class ThreadPool {
+public:
+	// numThreads counts the calling thread, 0 uses one thread per core
+	explicit ThreadPool(int numThreads = 0);
+	~ThreadPool();
+
+	int getNumThreads() const;
+	void parallelFor(int count, const std::function<void(int)> &job);
+
+private:
+	ThreadPool(const ThreadPool &);
+	ThreadPool &operator=(const ThreadPool &);
+
+	void workerLoop();
+	void runJob();
+
+	std::vector<std::thread> workers;
+	std::mutex mutex;
+	std::condition_variable wake, done;
+
+	const std::function<void(int)> *job;
+	int count;
+	std::atomic<int> next;
+	int busyWorkers;
+	unsigned int generation;
+	bool quit;
+};
+
+//===========================================================================
+// Inlined implementations
+//===========================================================================
+inline int ThreadPool::getNumThreads() const {
+	return (int)workers.size() + 1;
+}
+
+}
+
+#endif // THREAD_POOL_HPP
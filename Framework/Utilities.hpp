@@ -88,6 +88,17 @@ inline T myMax(T x, T y) { return (x > y) ? x : y; }
 template <class T>
 inline T SIGN(T x) { return (x > 0) ? 1 : -1; }
 
+// index of the highest set bit, x must not be 0
+inline int highestBit(unsigned long long x) {
+#if defined(_MSC_VER)
+	unsigned long i;
+	_BitScanReverse64(&i, x);
+	return (int)i;
+#else
+	return 63 - __builtin_clzll(x);
+#endif
+}
+
 #define SAFE_DELETE(p) if(p) { delete p; p=NULL; }
 #define SAFE_DELETE_ARRAY(p) if(p) { delete [] p; p=NULL; }
 
@@ -5,6 +5,8 @@
 #include "Framework/Platforms/Desktop.hpp"
 #include "Framework/Texture.hpp"
 
+#include "Benchmark.hpp"
+
 #include "States/LandscapeScene.hpp"
 #include "States/SplashState.hpp"
 
@@ -14,6 +16,7 @@ using namespace as;
 
 int main(int argc, char **argv) {
 	sprintf(remoteIPStr, "127.0.0.1");
+	bool bench = false;
 
 	if (argc >= 2) {
 		for (int i = 1; i < argc; i++) {
@@ -25,12 +28,19 @@ int main(int argc, char **argv) {
 				strcpy(remoteIPStr, argv[i+1]);
 			else if (!strcmp(argv[i], "fullscreen"))
 				fullscreen = true;
+			else if (!strcmp(argv[i], "autosave") && i < argc - 1)
+				autosaveInterval = atoi(argv[i+1]);
+			else if (!strcmp(argv[i], "bench"))
+				bench = true;
 		}
 	}
 
 	LibSdl lsdl;
 	initGL();
 
+	if (bench)
+		return runBenchmark() ? 0 : 1;
+
 	StateManager *g = StateManager::getInstance();
 
 	State *s = new SplashState(g);
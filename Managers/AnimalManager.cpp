@@ -1,14 +1,16 @@
 // AnimalManager.cpp
 
-// TODO: Make sure pigs/animals can't fall from map borders (<0,>MAP_X, ..., <0,>MAP_Z)!
+// TODO: Make sure pigs/animals can't fall from the map border at x/z = 0!
 
 
 
 #include <cstdlib>
 #include <ctime>
 #include <cmath>
+#include <cstring>
 
 #include "AnimalManager.hpp"
+#include "../Framework/ByteBuffer.hpp"
 #include "../Rendering/Voxelrenderer/ChunkMeshRenderer.hpp"
 #include "../Rendering/Meshes/CubeVertices.hpp"
 
@@ -219,9 +221,15 @@ void AnimalManager::spawnAnimals() {
 			pos.x = camPos->x + (float)(rand() % (Terrain::CHUNK_SIZE * 2) - Terrain::CHUNK_SIZE);
 			pos.y = (float)(Terrain::MAX_Y);
 			pos.z = camPos->z + (float)(rand() % (Terrain::CHUNK_SIZE * 2) - Terrain::CHUNK_SIZE);
-		} else
-			pos = Vec3((float)(rand() % Terrain::MAX_X), (float)Terrain::MAX_Y, (float)(rand() % Terrain::MAX_Z));
+		} else { // the others anywhere in the loaded area
+			int range = terrain->getLoadRadius() * Terrain::CHUNK_SIZE;
+			pos.x = camPos->x + (float)(rand() % (range * 2 + 1) - range);
+			pos.y = (float)(Terrain::MAX_Y);
+			pos.z = camPos->z + (float)(rand() % (range * 2 + 1) - range);
+		}
 		
+		if(pos.x < 0.0f || pos.z < 0.0f || !terrain->isLoaded((int)pos.x, (int)pos.z)) { i = i > 0 ? i-1 : i; continue; }
+
 		pos.y = (float)terrain->getYOfBlockBelow((int)pos.x, (int)pos.y, (int)pos.z) + 2;
 		if(pos.y >= Terrain::MAX_Y) { i = i > 0 ? i-1 : i; continue; }
 		
@@ -298,6 +306,12 @@ void AnimalManager::update(ticks_t delta) {
 			}
 		}
 
+		// don't let animals fall through columns which got evicted
+		if(!terrain->isLoaded((int)p1->pos.x, (int)p1->pos.z)) {
+			++it;
+			continue;
+		}
+
 		p1->update(delta);		
 
 		// check for collisions
@@ -417,6 +431,35 @@ std::list<AnimalOverlay> *AnimalManager::genOverlays()
 	return overlays;
 }
 
+void AnimalManager::loadAnimals(const WorldFile &file) {
+	if(noAnimals) return;
+
+	const std::vector<uchar> &data = file.getSection(WorldFile::SEC_ANIMALS);
+	ByteReader r(data.data(), data.size());
+
+	releaseAnimals();
+
+	int l = r.getInt();
+	for (int i = 0; i < l; i++) {
+		Animal a;
+		a.pos.x = r.getFloat();
+		a.pos.y = r.getFloat();
+		a.pos.z = r.getFloat();
+		a.rot = r.getFloat();
+		a.atype = (Animal::AnimalType)r.getByte();
+
+		uchar nameLen = r.getByte();
+		if (nameLen >= sizeof(a.name)) break;
+		r.getBytes(a.name, nameLen);
+		a.name[nameLen] = '\0';
+
+		if (!r.ok() || a.atype >= Animal::NUM_ANIMALS) break;
+
+		animals.push_back(new Animal(&a));
+	}
+}
+
+// worlds of older versions
 void AnimalManager::loadFromFile(const char *filename) {
 	if(noAnimals) return;
 	
@@ -448,33 +491,28 @@ void AnimalManager::loadFromFile(const char *filename) {
 // TODO: Write better persistency methods (using append? single file for more info? serialization?)
 
 // TODO: Fix memory leak!
-void AnimalManager::saveToFile(const char *filename) const {
+void AnimalManager::addToSnapshot(WorldSnapshot *snapshot) const {
 	if(noAnimals) return;
-	
-	char dataFilename[BUF_LEN], descrFilename[BUF_LEN];
-    int l = static_cast<int>(animals.size());
-
-	strcpy(dataFilename, filename);
-	strcpy(descrFilename, filename);
 
-	strcat(dataFilename, ".animals");
-	strcat(descrFilename, ".adescr");
-
-	binaryWrite(descrFilename, &l, sizeof(int));
-
-	Animal *animalArray = new Animal[l];
+	std::vector<uchar> data;
+	ByteWriter w(&data);
+	w.putInt((int)animals.size());
 
 	std::list<Animal *>::const_iterator it;
-	int i = 0;
 	for (it = animals.begin(); it != animals.end(); ++it) {
-		Animal *aptr = (*it);
-		//memcpy(&animalArray[i++], aptr, sizeof(Animal));
-		animalArray[i++] = Animal(aptr);
+		const Animal *a = (*it);
+		w.putFloat(a->pos.x);
+		w.putFloat(a->pos.y);
+		w.putFloat(a->pos.z);
+		w.putFloat(a->rot);
+		w.putByte((uchar)a->atype);
+
+		uchar nameLen = (uchar)strlen(a->name);
+		w.putByte(nameLen);
+		w.putBytes(a->name, nameLen);
 	}
 
-	binaryWrite(dataFilename, animalArray, sizeof(Animal) * l);
-
-	SAFE_DELETE_ARRAY(animalArray);
+	snapshot->getFile().setSection(WorldFile::SEC_ANIMALS, &data);
 }
 
 }
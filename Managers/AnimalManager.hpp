@@ -103,8 +103,9 @@ public:
 
 	std::list<AnimalOverlay> *genOverlays();
 	
+	void loadAnimals(const WorldFile &file);
 	void loadFromFile(const char *filename);
-	void saveToFile(const char *filename) const;
+	void addToSnapshot(WorldSnapshot *snapshot) const;
 	
 	static void setupAnimalMeshes(float brightness = 1.0f);
 	
@@ -0,0 +1,135 @@
+// FluidManager.cpp
+
+
+
+#include <algorithm>
+
+#include "../Framework/Utilities.hpp"
+
+#include "FluidManager.hpp"
+
+namespace as {
+
+static const int SIDES[4][2] = { {-1, 0}, {1, 0}, {0, -1}, {0, 1} };
+
+FluidManager::FluidManager(Terrain *_terrain)
+:	terrain(_terrain),
+	lastTick(0),
+	applying(false)
+{}
+
+void FluidManager::update() {
+	if (getTicks() - lastTick < TICK_INTERVAL)
+		return;
+
+	lastTick = getTicks();
+	tick();
+}
+
+// single blocks come with their position, edit batches with the blocks they set
+// per section, sections only touched by light have none
+void FluidManager::update(BlockPos *changed) {
+	if (applying || terrain->isEntityUpdate())
+		return;
+
+	if (terrain->isSectionUpdate()) {
+		const std::vector<BlockPos> &changes = terrain->getSectionChanges();
+		for (size_t i = 0; i < changes.size(); i++) {
+			activate(changes[i].x, changes[i].y, changes[i].z);
+			activateDependents(changes[i].x, changes[i].y, changes[i].z);
+		}
+		return;
+	}
+
+	activate(changed->x, changed->y, changed->z);
+	activateDependents(changed->x, changed->y, changed->z);
+}
+
+// what the air or flowing water at x/y/z should be given its neighbours
+DATA_TYPE FluidManager::flowAt(int x, int y, int z) const {
+	if (levelOf(terrain->get(x, y + 1, z)) >= 0)
+		return flowingWater(1);
+
+	int level = MAX_LEVEL + 1;
+	for (int d = 0; d < 4; d++) {
+		int nx = x + SIDES[d][0], nz = z + SIDES[d][1];
+		int n = levelOf(terrain->get(nx, y, nz));
+		if (n >= 0 && n + 1 < level && restsOnGround(nx, y, nz))
+			level = n + 1;
+	}
+	return (level <= MAX_LEVEL) ? flowingWater(level) : (DATA_TYPE)BlockType::AIR;
+}
+
+// water only spreads sideways once it can't fall any further
+bool FluidManager::restsOnGround(int x, int y, int z) const {
+	if (y == 0)
+		return true;
+
+	DATA_TYPE below = terrain->get(x, y - 1, z);
+	return below != BlockType::AIR && levelOf(below) <= 0;
+}
+
+void FluidManager::tick() {
+	// new cells queue up behind the ones of this tick, water moves a block per tick
+	size_t n = MIN(active.size(), (size_t)CELLS_PER_TICK);
+	writes.clear();
+
+	for (size_t i = 0; i < n; i++) {
+		BlockPos pos = active.front();
+		active.pop_front();
+		queued.erase(pos);
+
+		DATA_TYPE val = terrain->get(pos.x, pos.y, pos.z);
+		if (val != BlockType::AIR && levelOf(val) <= 0)
+			continue;
+
+		DATA_TYPE flow = flowAt(pos.x, pos.y, pos.z);
+		if (flow != val) {
+			Write write = { ChunkColumn::makeKey(pos.x >> Terrain::CHUNK_SHIFT, pos.z >> Terrain::CHUNK_SHIFT), pos, flow };
+			writes.push_back(write);
+		}
+	}
+
+	if (writes.empty())
+		return;
+
+	std::sort(writes.begin(), writes.end());
+
+	applying = true;
+	terrain->beginEdit(false);
+	for (size_t i = 0; i < writes.size(); i++) {
+		terrain->set(writes[i].pos.x, writes[i].pos.y, writes[i].pos.z, writes[i].val);
+	}
+	terrain->commitEdit();
+	applying = false;
+
+	for (size_t i = 0; i < writes.size(); i++) {
+		activateDependents(writes[i].pos.x, writes[i].pos.y, writes[i].pos.z);
+	}
+}
+
+// only air and flowing water ever change
+void FluidManager::activate(int x, int y, int z) {
+	if ((uint)y >= (uint)Terrain::MAX_Y || !terrain->isLoaded(x, z))
+		return;
+
+	DATA_TYPE val = terrain->get(x, y, z);
+	if (val != BlockType::AIR && levelOf(val) <= 0)
+		return;
+
+	BlockPos pos(x, y, z);
+	if (queued.insert(pos).second)
+		active.push_back(pos);
+}
+
+// the block below falls from x/y/z, the ones beside spread from it and so do
+// the ones beside the block above once that rests on x/y/z
+void FluidManager::activateDependents(int x, int y, int z) {
+	activate(x, y - 1, z);
+	for (int d = 0; d < 4; d++) {
+		activate(x + SIDES[d][0], y, z + SIDES[d][1]);
+		activate(x + SIDES[d][0], y + 1, z + SIDES[d][1]);
+	}
+}
+
+}
@@ -0,0 +1,100 @@
+// FluidManager.hpp
+
+#ifndef FLUID_MANAGER_HPP
+#define FLUID_MANAGER_HPP
+
+#include <deque>
+#include <unordered_set>
+#include <vector>
+
+#include "../Framework/Observable.hpp"
+#include "../Terrain.hpp"
+
+namespace as {
+
+/**
+ Lets water flow from its sources (BlockType::WATER). Flowing water
+ (BlockType::FLOWING_WATER) gets level 1 below any water and one more than its
+ lowest neighbour beside it, if that neighbour rests on something. Beyond
+ NUM_FLOW_LEVELS it dries up again, so water spreads, settles and recedes once
+ its source is gone.
+
+ Only cells which may change are looked at: those around blocks set by others
+ (observed through the terrain) or by the simulation itself. At most
+ CELLS_PER_TICK of them are updated per tick, the rest wait for the next one.
+ All writes of a tick are applied in one edit batch, sorted by column.
+*/
+class FluidManager : public Observer<BlockPos> {
+public:
+	explicit FluidManager(Terrain *terrain);
+
+	// advances the simulation by a tick every TICK_INTERVAL
+	void update();
+	virtual void update(BlockPos *changed);
+
+	// cells waiting for an update
+	size_t getNumActive() const;
+
+	enum Consts {
+		TICK_INTERVAL	= 250,
+		CELLS_PER_TICK	= 512,
+		MAX_LEVEL		= BlockType::NUM_FLOW_LEVELS
+	};
+
+private:
+	struct Write {
+		ChunkKey key;
+		BlockPos pos;
+		DATA_TYPE val;
+
+		bool operator<(const Write &other) const;
+	};
+
+	// 0 for sources, 1..MAX_LEVEL for flowing water, -1 for anything else
+	static int levelOf(DATA_TYPE val);
+	static DATA_TYPE flowingWater(int level);
+
+	DATA_TYPE flowAt(int x, int y, int z) const;
+	bool restsOnGround(int x, int y, int z) const;
+
+	void tick();
+	void activate(int x, int y, int z);
+	void activateDependents(int x, int y, int z);
+
+	Terrain *terrain;
+
+	std::deque<BlockPos> active;
+	std::unordered_set<BlockPos, BlockPosHash> queued;
+	std::vector<Write> writes;
+
+	ticks_t lastTick;
+	// ignores the notifications caused by its own writes
+	bool applying;
+};
+
+//===========================================================================
+// Inlined implementations
+//===========================================================================
+inline size_t FluidManager::getNumActive() const {
+	return active.size();
+}
+
+inline bool FluidManager::Write::operator<(const Write &other) const {
+	return key < other.key;
+}
+
+inline int FluidManager::levelOf(DATA_TYPE val) {
+	if (val == BlockType::WATER)
+		return 0;
+	if (val >= BlockType::FLOWING_WATER && val < BlockType::FLOWING_WATER + MAX_LEVEL)
+		return val - BlockType::FLOWING_WATER + 1;
+	return -1;
+}
+
+inline DATA_TYPE FluidManager::flowingWater(int level) {
+	return (DATA_TYPE)(BlockType::FLOWING_WATER + level - 1);
+}
+
+}
+
+#endif // FLUID_MANAGER_HPP
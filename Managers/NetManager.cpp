@@ -249,27 +249,31 @@ void NetManager::strToLocalIP(char *str) {
 }
 
 void NetManager::sendTerrain() {
-	DATA_TYPE *data = t->getDataPtr();
+	DATA_TYPE *data = new DATA_TYPE[Terrain::LEGACY_TERRAIN_SIZE*Terrain::LEGACY_TERRAIN_HEIGHT*Terrain::LEGACY_TERRAIN_SIZE];
+	t->exportBlocks(data);
 
 	// compress before!
-	sendBlocked(data, Terrain::MAX_X*Terrain::MAX_Y*Terrain::MAX_Z);
+	sendBlocked(data, Terrain::LEGACY_TERRAIN_SIZE*Terrain::LEGACY_TERRAIN_HEIGHT*Terrain::LEGACY_TERRAIN_SIZE);
+	SAFE_DELETE_ARRAY(data);
 
-	std::list<Entity> *entities = t->getEntitiesPtr();
+	std::list<Entity> entities = t->getAllEntities();
 
-	int numEntities = (int)entities->size();
+	int numEntities = (int)entities.size();
 	sendBlocked(&numEntities, sizeof(int));
 
 	std::list<Entity>::const_iterator it;
-	for (it = entities->begin(); it != entities->end(); ++it) {
+	for (it = entities.begin(); it != entities.end(); ++it) {
 		sendBlocked(&(*it), sizeof(Entity));
 	}
 }
 
 void NetManager::receiveTerrain() {
-	DATA_TYPE *data = t->getDataPtr();
+	DATA_TYPE *data = new DATA_TYPE[Terrain::LEGACY_TERRAIN_SIZE*Terrain::LEGACY_TERRAIN_HEIGHT*Terrain::LEGACY_TERRAIN_SIZE];
 
 	// decompress here!
-	recvBlocked(data, Terrain::MAX_X*Terrain::MAX_Y*Terrain::MAX_Z);
+	recvBlocked(data, Terrain::LEGACY_TERRAIN_SIZE*Terrain::LEGACY_TERRAIN_HEIGHT*Terrain::LEGACY_TERRAIN_SIZE);
+	t->importBlocks(data);
+	SAFE_DELETE_ARRAY(data);
 
 	int numEntities = 0;
 	recvBlocked(&numEntities, sizeof(int));
@@ -359,8 +363,12 @@ bool NetManager::recvPart() {
 	BlockPos entDelMsg;
 
 	uchar buf[NBUF_LEN];
-	
-	while(dataSocket.available()) {
+	bool quit = false;
+
+	// bursts of block messages are committed together, the other player's edits aren't ours to undo
+	t->beginEdit(false);
+
+	while(!quit && dataSocket.available()) {
 		MessageTypes type = recvUnblocked(buf);
 
 		switch(type) {
@@ -386,12 +394,13 @@ bool NetManager::recvPart() {
 			break;
 		case MT_QUIT:
 			otherQuit = true;
-			return true;
+			quit = true;
 			break;
 		}
 	}
 
-	return false;
+	t->commitEdit();
+	return quit;
 }
 
 class AcceptRunner : public Poco::Runnable {
@@ -19,7 +19,7 @@ void TNTManager::explodePos(int a, int b, int c, int y) {
 	if (!texIndex || b == 0) return;
 
 	if (texIndex != TNT_TEX_INDEX + 1) {
-		terrain->lazySet(a, b, c, 0);
+		terrain->set(a, b, c, 0);
 		// FIXME: Fix staying ind mid air and not vanishing particles bug!
 		renderer->addExplAt(a, b, c, texIndex, y - EXPL_RADIUS);
 		terrain->removeEntityAt(a, b, c, (CubeFace)23);
@@ -52,13 +52,17 @@ TNTManager::TNTManager(LandscapeRenderer *_renderer, Terrain *_terrain)
 		: renderer(_renderer), terrain(_terrain), lastExplTime(0) {}
 
 void TNTManager::update() {
+	// a blast touches lots of blocks, let the renderer see it as one change per section,
+	// it goes off on its own later, so it isn't undone with the player's edits
+	terrain->beginEdit(false);
+
 	std::list<TNTEntity>::iterator it = trigtnts.begin();
 	while (it != trigtnts.end()) {
 		TNTEntity tnt = (*it);
 		if (getTicks() - lastExplTime > TIME_BETWEEN_EXPL
 				&& getTicks() - tnt.timeTriggered > TRIGGER_TO_FIRE_DELAY) {
 			int tx = tnt.x, ty = tnt.y, tz = tnt.z;
-			terrain->lazySet(tx, ty, tz, 0);
+			terrain->set(tx, ty, tz, 0);
 			renderer->addExplAt(tx, ty, tz, TNT_TEX_INDEX, ty - EXPL_RADIUS);
 			terrain->removeEntityAt(tx, ty, tz, (CubeFace)23);
 			playSound(SND_DIG);
@@ -69,7 +73,7 @@ void TNTManager::update() {
 			++it;
 	}
 
-	terrain->lazySetFlush();
+	terrain->commitEdit();
 }
 
 void TNTManager::fireAt(int x, int y, int z) {
@@ -2,6 +2,8 @@
 
 
 
+#include <cfloat>
+
 #include "Framework/Math/Vector.hpp"
 
 #include "Managers/RailManager.hpp"
@@ -33,7 +35,8 @@ inline Vec3 Movement::genAhead(Vec3 dir, float c) const {
 }
 
 inline void Movement::restrictMovement() {
-	cam->restrictToBox(1, 1, 1, Terrain::MAX_X - 1, Terrain::MAX_Y + 5, Terrain::MAX_Z - 1);
+	// the world only ends at the origin and in height
+	cam->restrictToBox(1, 1, 1, FLT_MAX, Terrain::MAX_Y + 5, FLT_MAX);
 }
 
 inline bool Movement::isLadderAhead(int cx, int cy, int cz) const {
@@ -137,25 +140,20 @@ void Movement::update(ticks_t delta, bool crouching) {
 	walking = false;
 }
 
+// the camera and the block below it, one span test in the terrain's solid bits
+inline bool Movement::bodyFits(Vec3 v) const {
+	return terrain->isEmptySpan((int)v.x, (int)(v.y - 1), (int)v.y, (int)v.z);
+}
+
 bool Movement::resetPosIfCrashed(const Vec3 ahead) {
-	static Vec3 aheadBelow;
-	aheadBelow = Vec3(ahead.x, ahead.y - 1, ahead.z);
-	if (!terrain->isEmptyPos(ahead) || !terrain->isEmptyPos(aheadBelow)) {
+	if (!bodyFits(ahead)) {
 		Vec3 *camPos = cam->getPosPtr();
 
-		Vec3 aheadX = Vec3(ahead.x, oldPos.y, oldPos.z);
-		Vec3 aheadY = Vec3(oldPos.x, ahead.y, oldPos.z);
-		Vec3 aheadZ = Vec3(oldPos.x, oldPos.y, ahead.z);
-
-		Vec3 aheadXBelow = Vec3(ahead.x, oldPos.y - 1, oldPos.z);
-		Vec3 aheadYBelow = Vec3(oldPos.x, ahead.y - 1, oldPos.z);
-		Vec3 aheadZBelow = Vec3(oldPos.x, oldPos.y - 1, ahead.z);
-
-		if (!terrain->isEmptyPos(aheadX) || !terrain->isEmptyPos(aheadXBelow))
+		if (!bodyFits(Vec3(ahead.x, oldPos.y, oldPos.z)))
 			camPos->x = oldPos.x;
-		if (!terrain->isEmptyPos(aheadY) || !terrain->isEmptyPos(aheadYBelow))
+		if (!bodyFits(Vec3(oldPos.x, ahead.y, oldPos.z)))
 			camPos->y = oldPos.y;
-		if (!terrain->isEmptyPos(aheadZ) || !terrain->isEmptyPos(aheadZBelow))
+		if (!bodyFits(Vec3(oldPos.x, oldPos.y, ahead.z)))
 			camPos->z = oldPos.z;
 
 		return true;
@@ -34,6 +34,7 @@ public:
 private:
 	Vec3 genAhead(Vec3 dir, float c) const;
 	void commonMovement(Vec3 dir, float d, bool crouching, ticks_t delta);
+	bool bodyFits(Vec3 v) const;
 	bool resetPosIfCrashed(const Vec3 ahead);
 	bool resetIfFalling(const Vec3 ahead);
 	void updateFall(ticks_t delta);
@@ -0,0 +1,169 @@
+// RegionFile.cpp
+
+
+
+#include <climits>
+#include <cstring>
+
+#include "Framework/Utilities.hpp"
+#include "Framework/ByteBuffer.hpp"
+
+#include "RegionFile.hpp"
+
+namespace as {
+
+RegionFile::RegionFile(const std::string &_filename, int _rx, int _rz)
+:	filename(_filename),
+	rx(_rx),
+	rz(_rz),
+	exists(fileExists(_filename.c_str())),
+	mapped(NULL),
+	mappedSize(0)
+{
+	memset(entries, 0, sizeof(entries));
+	usedSectors.assign(HEADER_SECTORS, true);
+
+	if (exists)
+		loadIndex();
+}
+
+RegionFile::~RegionFile() {
+	unmap();
+}
+
+bool RegionFile::map() {
+	if (!mapped && exists)
+		mapped = (const uchar *)mapFile(filename.c_str(), &mappedSize);
+	return mapped != NULL;
+}
+
+void RegionFile::unmap() {
+	if (!mapped) return;
+	unmapFile(mapped, mappedSize);
+	mapped = NULL;
+	mappedSize = 0;
+}
+
+// missing bytes past the end of the file read as zeros
+void RegionFile::readAt(size_t offset, void *dest, size_t size) {
+	if (!map()) {
+		memset(dest, 0, size);
+		binaryReadAt(filename.c_str(), offset, dest, size);
+		return;
+	}
+
+	size_t avail = (offset < mappedSize) ? mappedSize - offset : 0;
+	if (avail > size) avail = size;
+	memcpy(dest, mapped + offset, avail);
+	memset((uchar *)dest + avail, 0, size - avail);
+}
+
+void RegionFile::loadIndex() {
+	uchar header[HEADER_SIZE];
+	readAt(0, header, HEADER_SIZE);
+
+	ByteReader r(header, HEADER_SIZE);
+	if (r.getInt() != MAGIC || r.getInt() != VERSION)
+		error("World file is damaged!");
+
+	for (int i = 0; i < NUM_COLUMNS; i++) {
+		Entry &entry = entries[i];
+		entry.sector = r.getInt();
+		entry.size = r.getInt();
+		if (entry.size == 0) continue;
+
+		int numSectors = (entry.size + SECTOR_SIZE - 1) / SECTOR_SIZE;
+		if (entry.size < 0 || entry.sector < HEADER_SECTORS || entry.sector > INT_MAX / SECTOR_SIZE - numSectors)
+			error("World file is damaged!");
+
+		if ((int)usedSectors.size() < entry.sector + numSectors)
+			usedSectors.resize(entry.sector + numSectors, false);
+		for (int s = entry.sector; s < entry.sector + numSectors; s++) {
+			if (usedSectors[s])
+				error("World file is damaged!");
+			usedSectors[s] = true;
+		}
+	}
+}
+
+void RegionFile::createFile() {
+	std::vector<uchar> header;
+	ByteWriter w(&header);
+	w.putInt(MAGIC);
+	w.putInt(VERSION);
+	header.resize(HEADER_SECTORS * SECTOR_SIZE, 0);
+
+	binaryWriteAt(filename.c_str(), 0, &header[0], header.size());
+	exists = true;
+}
+
+bool RegionFile::read(ChunkKey key, std::vector<uchar> *blob) {
+	const Entry &entry = entries[indexOf(key)];
+	if (entry.size == 0)
+		return false;
+
+	blob->resize(entry.size);
+	readAt((size_t)entry.sector * SECTOR_SIZE, &(*blob)[0], entry.size);
+	return true;
+}
+
+void RegionFile::write(ChunkKey key, const std::vector<uchar> &blob) {
+	if (blob.empty()) return;
+	unmap();
+	if (!exists)
+		createFile();
+
+	int index = indexOf(key);
+	Entry old = entries[index];
+
+	int sector = allocate(((int)blob.size() + SECTOR_SIZE - 1) / SECTOR_SIZE);
+	binaryWriteAt(filename.c_str(), (size_t)sector * SECTOR_SIZE, &blob[0], blob.size());
+
+	entries[index].sector = sector;
+	entries[index].size = (int)blob.size();
+	writeEntry(index);
+	release(old);
+}
+
+void RegionFile::writeEntry(int index) {
+	std::vector<uchar> buf;
+	ByteWriter w(&buf);
+	w.putInt(entries[index].sector);
+	w.putInt(entries[index].size);
+	binaryWriteAt(filename.c_str(), 8 + index * 8, &buf[0], buf.size());
+}
+
+// first fit, the file grows if no gap is large enough
+int RegionFile::allocate(int numSectors) {
+	int start = HEADER_SECTORS, run = 0;
+	for (int s = HEADER_SECTORS; run < numSectors; s++) {
+		if (s < (int)usedSectors.size() && usedSectors[s]) {
+			run = 0;
+			start = s + 1;
+		} else run++;
+	}
+
+	if ((int)usedSectors.size() < start + numSectors)
+		usedSectors.resize(start + numSectors, false);
+	for (int s = start; s < start + numSectors; s++) {
+		usedSectors[s] = true;
+	}
+	return start;
+}
+
+void RegionFile::release(const Entry &entry) {
+	if (entry.size == 0) return;
+	int numSectors = (entry.size + SECTOR_SIZE - 1) / SECTOR_SIZE;
+	for (int s = entry.sector; s < entry.sector + numSectors; s++) {
+		usedSectors[s] = false;
+	}
+}
+
+void RegionFile::getColumnKeys(std::vector<ChunkKey> *keys) const {
+	for (int i = 0; i < NUM_COLUMNS; i++) {
+		if (entries[i].size != 0)
+			keys->push_back(ChunkColumn::makeKey((rx << EDGE_SHIFT) | (i >> EDGE_SHIFT), (rz << EDGE_SHIFT) | (i & (EDGE - 1))));
+	}
+}
+
+}
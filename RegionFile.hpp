@@ -0,0 +1,92 @@
+// RegionFile.hpp
+
+#ifndef REGION_FILE_HPP
+#define REGION_FILE_HPP
+
+#include <string>
+#include <vector>
+
+#include "ChunkColumn.hpp"
+
+namespace as {
+
+/**
+ A square of EDGE x EDGE columns in one file, read and written column by column:
+
+	header		magic, version, then first sector and size of each column (0 if absent)
+	sectors		the encoded columns (see ChunkColumn::encode), each at a SECTOR_SIZE boundary
+
+ A rewritten column goes to free sectors before its index entry is switched over,
+ so an interrupted save leaves the previous version readable.
+
+ Reads go through a read only mapping of the file, so only the pages of the
+ columns actually loaded are paged in. Writes drop the mapping, the next read
+ maps the grown file again.
+*/
+class RegionFile {
+public:
+	enum Consts {
+		MAGIC = 0x52574B53, // "SKWR"
+		VERSION = 1,
+
+		EDGE_SHIFT = 5,
+		EDGE = 1 << EDGE_SHIFT,
+		NUM_COLUMNS = EDGE * EDGE,
+
+		SECTOR_SIZE = 512,
+		HEADER_SIZE = 8 + NUM_COLUMNS * 8,
+		HEADER_SECTORS = (HEADER_SIZE + SECTOR_SIZE - 1) / SECTOR_SIZE
+	};
+
+	// reads the index if the file exists
+	RegionFile(const std::string &filename, int rx, int rz);
+	~RegionFile();
+
+	bool read(ChunkKey key, std::vector<uchar> *blob);
+	void write(ChunkKey key, const std::vector<uchar> &blob);
+	void getColumnKeys(std::vector<ChunkKey> *keys) const;
+
+	static ChunkKey regionOf(ChunkKey key);
+
+private:
+	struct Entry {
+		int sector, size;
+	};
+
+	RegionFile(const RegionFile &);
+	RegionFile &operator=(const RegionFile &);
+
+	static int indexOf(ChunkKey key);
+	// false if the file can't be mapped, reads fall back to binaryReadAt() then
+	bool map();
+	void unmap();
+	void readAt(size_t offset, void *dest, size_t size);
+	void loadIndex();
+	void createFile();
+	void writeEntry(int index);
+	int allocate(int numSectors);
+	void release(const Entry &entry);
+
+	std::string filename;
+	int rx, rz;
+	bool exists;
+	const uchar *mapped;
+	size_t mappedSize;
+	Entry entries[NUM_COLUMNS];
+	std::vector<bool> usedSectors;
+};
+
+//===========================================================================
+// Inlined implementations
+//===========================================================================
+inline ChunkKey RegionFile::regionOf(ChunkKey key) {
+	return ChunkColumn::makeKey((int)(key >> 32) >> EDGE_SHIFT, (int)key >> EDGE_SHIFT);
+}
+
+inline int RegionFile::indexOf(ChunkKey key) {
+	return (((int)(key >> 32) & (EDGE - 1)) << EDGE_SHIFT) | ((int)key & (EDGE - 1));
+}
+
+}
+
+#endif // REGION_FILE_HPP
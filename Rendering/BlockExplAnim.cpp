@@ -49,7 +49,7 @@ BlockExplAnim::BlockExplAnim(int _x, int _y, int _z, int texId, int _blockBelowY
 	int k = 0;
 	float kx, ky, kz;
 	
-	float brightness = ChunkMesh::getDaylightFactor() * (t->isBlockAbove(x, y, z) ? 0.5f : 1.0f);
+	float brightness = ChunkMesh::getBrightness(t->getLight(x, y, z));
 
 	for (int i = 0; i < NUM_PARTICLES; i++) {
 		kx = ((rand() % 98) + 1) * 0.01f;
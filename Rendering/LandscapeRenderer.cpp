@@ -12,7 +12,6 @@
 #include "Voxelrenderer/ChunkMeshRenderer.hpp"
 
 #include "Meshes/BlockMesh.hpp"
-#include "Meshes/CubeVertices.hpp"
 
 #include "LandscapeRenderer.hpp"
 #include "BlockExplAnim.hpp"
@@ -25,7 +24,7 @@ const float HLIGHT_FACE_OFFSET = 0.01f;
 
 LandscapeRenderer::LandscapeRenderer(Terrain *_terrain, RailManager *_railManager, Camera *_cam, AnimalManager *_animalManager)
 :	voxelRenderer(NULL),
-	selectedBlock(NULL),
+	hasSelection(false),
 	terrain(_terrain),
 	cam(_cam),
 	highlightBlock(NULL),
@@ -71,7 +70,6 @@ void LandscapeRenderer::setupFog(float factor) {
 LandscapeRenderer::~LandscapeRenderer() {
 	SAFE_DELETE(explAnimMgr);
 	SAFE_DELETE(voxelRenderer);
-	SAFE_DELETE(selectedBlock);
 	SAFE_DELETE(highlightBlock);
 }
 
@@ -95,93 +93,30 @@ void LandscapeRenderer::render(bool highlightSelBlock) {
 BlockPos lastSelBlock;
 #endif
 
-void LandscapeRenderer::updateSelectedBlock(std::list<BlockPos> *blocksNearCam, int x, int y) {
+void LandscapeRenderer::updateSelectedBlock(int x, int y) {
 	Ray pRay = cam->getPickRay(x, y);
 
-	std::vector<float> *tris = genTrianglesOfBlocksAtPositions(blocksNearCam, &pRay);
-
-	SAFE_DELETE(selectedBlock);
-
-	if (intersector::intersectRayTriangles(&pRay, tris, &isect)) {
-		selectedFace = determineSelectedFace();
-		selectedBlock = new BlockPos((int)(isect.x), (int)(isect.y), (int)(isect.z));
+	hasSelection = terrain->raycast(pRay.origin, pRay.direction, (float)nearDist, &selection);
 
 #if DEBUG_MODE
-		// FOR DEBUGGING
-		if (!(selectedBlock == lastSelBlock))) {
-			std::printf("Selected block: (%d,%d,%d)\n", selectedBlock->x, selectedBlock->y, selectedBlock->z);
-			fflush(stdout);
-			lastSelBlock = BlockPos(selectedBlock);
-		}
-#endif
-
-	} else {
-		selectedBlock = NULL;
+	// FOR DEBUGGING
+	if (hasSelection && !(selection.pos == lastSelBlock)) {
+		std::printf("Selected block: (%d,%d,%d)\n", selection.pos.x, selection.pos.y, selection.pos.z);
+		fflush(stdout);
+		lastSelBlock = selection.pos;
 	}
-
-	SAFE_DELETE(tris);
+#endif
 }
 
 void LandscapeRenderer::highlightSelectedBlock() {
-	if (selectedBlock) {
+	if (hasSelection) {
 		glPushMatrix();
-		glTranslatef((float)(int)(isect.x), (float)(int)(isect.y), (float)(int)(isect.z));
-		highlightFace(selectedFace);
+		glTranslatef((float)selection.pos.x, (float)selection.pos.y, (float)selection.pos.z);
+		highlightFace(selection.face);
 		glPopMatrix();
 	}
 }
 
-float rayPointDistanceSquared(Ray *ray, Vec3 *point) {
-	Vec3 w = *point - ray->origin;
-	float projectedDist = w * ray->direction;
-	return w.lengthSquared() - projectedDist*projectedDist;
-}
-
-std::vector<float> *LandscapeRenderer::genTrianglesOfBlocksAtPositions(std::list<BlockPos> *blocksNearCam, Ray *ray) {
-	std::vector<float> *tris = NULL;
-	std::vector<float> *result = new std::vector<float>();
-	Vec3 blockCenter;
-
-	std::list<BlockPos>::iterator it;
-	for (it = blocksNearCam->begin(); it != blocksNearCam->end(); ++it) {
-		BlockPos pos(*it);
-
-		int px = pos.x, py = pos.y, pz = pos.z;
-		
-		blockCenter = Vec3(px+0.5f, py+0.5f, pz+0.5f);
-		if(rayPointDistanceSquared(ray, &blockCenter) > 0.5f)
-			continue;
-
-		VisibleFaces vfaces = terrain->determineVisibleFaces(px, py, pz);
-
-		tris = genTrianglesOfBlockAtPos(px, py, pz, vfaces);
-
-#if DEBUG_MODE
-		glDisable(GL_TEXTURE_2D);
-		glDisable(GL_CULL_FACE);
-		drawModeWireframe();
-		glPointSize(4);
-		glColor4f(1.0f, 0.0f, 0.0f, 1.0f);
-		glBegin(GL_TRIANGLES);
-		for (int b = 0; b < tris->size(); b += 3) {
-			glVertex3f((*tris)[b], (*tris)[b+1] + 0.1f, (*tris)[b+2]);
-		}
-		glEnd();
-		glColor4f(1.0f, 1.0f, 1.0f, 1.0f);
-		drawModeFilled();
-		glEnable(GL_TEXTURE_2D);
-#endif
-
-		for (unsigned int q = 0; q < tris->size(); q++) {
-			result->push_back((*tris)[q]);
-		}
-
-		SAFE_DELETE(tris);
-	}
-
-	return result;
-}
-
 void LandscapeRenderer::highlightFace(CubeFace visFace) {
 	glDisable(GL_TEXTURE_2D);
 	glEnable(GL_BLEND);
@@ -217,29 +152,4 @@ void LandscapeRenderer::highlightFace(CubeFace visFace) {
 	glEnable(GL_TEXTURE_2D);
 }
 
-CubeFace LandscapeRenderer::determineSelectedFace() {
-	float 	dX = isect.x - (int)isect.x;
-	float	dY = isect.y - (int)isect.y;
-	float	dZ = isect.z - (int)isect.z;
-
-	if (dX < 0.1f)
-		return CF_LEFT;
-	else if (dX >= 0.9f)
-		return CF_RIGHT;
-
-	else if (dY < 0.1f)
-		return CF_BOTTOM;
-	else if (dY >= 0.9f)
-		return CF_TOP;
-
-	else if (dZ < 0.1f)
-		return CF_BACK;
-	else if (dZ >= 0.9f)
-		return CF_FRONT;
-
-	// there should be an INVALID value
-	assert(0);
-	return CF_FRONT;
-}
-
 } /* namespace as */
@@ -34,34 +34,30 @@ public:
 
 	void addExplAt(int x, int y, int z, int texId, int blockBelowY);
 
-	void updateSelectedBlock(std::list<BlockPos> *blocksNearCam, int x, int y);
+	void updateSelectedBlock(int x, int y);
 	
 	static void setupFog(float factor = 1.0f);
 
 private:
 	void highlightSelectedBlock();
-	std::vector<float> *genTrianglesOfBlocksAtPositions(std::list<BlockPos> *blocksNear, Ray *ray);
 	void highlightFace(CubeFace visFace);
-	CubeFace determineSelectedFace();
 	
 	IVoxelRenderer *voxelRenderer;
-	CubeFace selectedFace;
-	BlockPos *selectedBlock;
+	BlockHit selection;
+	bool hasSelection;
 	Terrain *terrain;
 	Camera *cam;
 	BlockMesh *highlightBlock;
 
 	BlockExplAnimManager *explAnimMgr;
-
-	Vec3 isect;
 };
 
 inline BlockPos *LandscapeRenderer::getSelectedBlock() {
-	return selectedBlock;
+	return hasSelection ? &selection.pos : NULL;
 }
 
 inline CubeFace LandscapeRenderer::getSelectedFace() {
-	return selectedFace;
+	return selection.face;
 }
 
 inline void LandscapeRenderer::addExplAt(int x, int y, int z, int texId, int blockBelowY) {
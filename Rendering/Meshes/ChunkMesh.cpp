@@ -12,9 +12,58 @@
 
 namespace as {
 
-const float MAX_LIGHT_DIST		= 2.0f;
+// brightness per light level, each level dims by 20%, but never completely dark
+static const float LIGHT_LEVELS[ChunkColumn::MAX_LIGHT + 1] = {
+	0.132f, 0.140f, 0.149f, 0.162f, 0.177f, 0.197f, 0.221f, 0.251f,
+	0.289f, 0.336f, 0.395f, 0.469f, 0.561f, 0.676f, 0.820f, 1.000f
+};
 
-const float FAKE_SHADOW_BNESS	= 0.5f;
+// by the bits side1 | side2 << 1 | corner << 2 of the blocks occluding a vertex,
+// both sides hide the corner
+static const float AO_BRIGHTNESS[8] = {
+	1.0f, 0.8f, 0.8f, 0.5f, 0.8f, 0.65f, 0.65f, 0.5f
+};
+
+// side1, side2 and corner block around each vertex of a face, relative to the block
+static const signed char AO_NEIGHBOURS[FACES_PER_BOX][UNIQUE_VERTICES_PER_QUAD][3][3] = {
+	// front
+	{ {{-1,  0,  1}, { 0,  1,  1}, {-1,  1,  1}},
+	  {{-1,  0,  1}, { 0, -1,  1}, {-1, -1,  1}},
+	  {{ 1,  0,  1}, { 0, -1,  1}, { 1, -1,  1}},
+	  {{ 1,  0,  1}, { 0,  1,  1}, { 1,  1,  1}} },
+	// back
+	{ {{ 1,  0, -1}, { 0,  1, -1}, { 1,  1, -1}},
+	  {{ 1,  0, -1}, { 0, -1, -1}, { 1, -1, -1}},
+	  {{-1,  0, -1}, { 0, -1, -1}, {-1, -1, -1}},
+	  {{-1,  0, -1}, { 0,  1, -1}, {-1,  1, -1}} },
+	// left
+	{ {{-1,  1,  0}, {-1,  0, -1}, {-1,  1, -1}},
+	  {{-1, -1,  0}, {-1,  0, -1}, {-1, -1, -1}},
+	  {{-1, -1,  0}, {-1,  0,  1}, {-1, -1,  1}},
+	  {{-1,  1,  0}, {-1,  0,  1}, {-1,  1,  1}} },
+	// right
+	{ {{ 1,  1,  0}, { 1,  0,  1}, { 1,  1,  1}},
+	  {{ 1, -1,  0}, { 1,  0,  1}, { 1, -1,  1}},
+	  {{ 1, -1,  0}, { 1,  0, -1}, { 1, -1, -1}},
+	  {{ 1,  1,  0}, { 1,  0, -1}, { 1,  1, -1}} },
+	// bottom
+	{ {{-1, -1,  0}, { 0, -1,  1}, {-1, -1,  1}},
+	  {{-1, -1,  0}, { 0, -1, -1}, {-1, -1, -1}},
+	  {{ 1, -1,  0}, { 0, -1, -1}, { 1, -1, -1}},
+	  {{ 1, -1,  0}, { 0, -1,  1}, { 1, -1,  1}} },
+	// top
+	{ {{ 1,  1,  0}, { 0,  1,  1}, { 1,  1,  1}},
+	  {{ 1,  1,  0}, { 0,  1, -1}, { 1,  1, -1}},
+	  {{-1,  1,  0}, { 0,  1, -1}, {-1,  1, -1}},
+	  {{-1,  1,  0}, { 0,  1,  1}, {-1,  1,  1}} }
+};
+
+// texture rect of a texture cell, see BlockType
+static inline TexCoordRect cellRect(int cell) {
+	int row = cell / NUM_TEX_PER_ROW, col = cell % NUM_TEX_PER_ROW;
+	return TexCoordRect(TEX_COORD_FACTOR * col, TEX_COORD_FACTOR * (col + 1),
+						TEX_COORD_FACTOR * row, TEX_COORD_FACTOR * (row + 1));
+}
 
 const float FRONT_BACK_DIM		= 0.4f;
 const float LEFT_RIGHT_DIM		= 0.2f;
@@ -41,6 +90,13 @@ void ChunkMesh::reset() {
 float ChunkMesh::getDaylightFactor() {
 	return daylightFactor;
 }
+
+// sky light follows the time of day, block light (torches) doesn't
+float ChunkMesh::getBrightness(uchar light) {
+	float sky = LIGHT_LEVELS[light >> ChunkColumn::SKY_LIGHT_SHIFT] * daylightFactor;
+	float block = LIGHT_LEVELS[light & ChunkColumn::MAX_LIGHT];
+	return MAX(sky, block);
+}
 	
 bool ChunkMesh::updateDaylightFactor() {
 	const ticks_t DAYLIGHT_UPDATE_TICKS = 5000;
@@ -102,6 +158,8 @@ void ChunkMesh::setupBuffers(int index) {
 	curIxIndex = 0;
 #endif
 
+	buildOccupancy(minY);
+
 	int i, j, k;
 	for (i = minX; i < maxX; i++) {
 		for (j = minY; j < maxY; j++) {
@@ -118,35 +176,53 @@ void ChunkMesh::setupBuffers(int index) {
 #endif
 }
 
-void ChunkMesh::update(int posY) {
-	if(posY == -1) {
-		for (int i = 0; i < NUM_SUBMESHES; i++) {
-			if(meshes[i])
-				setupBuffers(i);
+// one pass over the blocks instead of seven terrain lookups per block for
+// visible faces and another twelve per face for ambient occlusion
+void ChunkMesh::buildOccupancy(int minY) {
+	occupancyMinY = minY;
+	memset(occupancy, 0, sizeof(occupancy));
+
+	for (int x = minX - 1; x <= maxX; x++) {
+		OccupancyRow bit = (OccupancyRow)1 << (x - minX + 1);
+		for (int y = minY - 1; y <= minY + CHK_SUBMESH_HEIGHT; y++) {
+			OccupancyRow *row = occupancy[y - minY + 1];
+			for (int z = minZ - 1; z <= maxZ; z++) {
+				if (Terrain::castsShadow(terrain->get(x, y, z)))
+					row[z - minZ + 1] |= bit;
+			}
 		}
 	}
-	else {
-		int index = posY/CHK_SUBMESH_HEIGHT;
-		
-		if (index < 0 || index >= NUM_SUBMESHES)
-			return;
+}
 
-		if(!meshes[index])
-			meshes[index] = new MeshType();
+inline bool ChunkMesh::isOccupied(int x, int y, int z) const {
+	return (occupancy[y - occupancyMinY + 1][z - minZ + 1] >> (x - minX + 1)) & 1;
+}
 
-		setupBuffers(index);
+// same as Terrain::determineVisibleFaces()
+inline VisibleFaces ChunkMesh::visibleFaces(int x, int y, int z) const {
+	return VisibleFaces(!isOccupied(x, y, z + 1), !isOccupied(x, y, z - 1),
+						!isOccupied(x, y - 1, z), !isOccupied(x, y + 1, z),
+						!isOccupied(x - 1, y, z), !isOccupied(x + 1, y, z));
+}
 
-		int mod = posY % CHK_SUBMESH_HEIGHT;
-		if(mod == 0 && index - 1 >= 0) {
-			if (!meshes[index-1]) meshes[index-1] = new MeshType();
-			setupBuffers(index-1);
-		}
-		else if(mod == CHK_SUBMESH_HEIGHT - 1 && index + 1 < NUM_SUBMESHES) {
-			if (!meshes[index+1]) meshes[index+1] = new MeshType();
-			setupBuffers(index+1);
-		}
+void ChunkMesh::update() {
+	for (int i = 0; i < NUM_SUBMESHES; i++) {
+		if(meshes[i])
+			setupBuffers(i);
+	}
+}
+
+// submeshes line up with the terrain's sections
+void ChunkMesh::update(const ChunkColumn::SectionMask &sections) {
+	for (int i = 0; i < NUM_SUBMESHES; i++) {
+		if (!sections.test(i))
+			continue;
+
+		if(!meshes[i])
+			meshes[i] = new MeshType();
+
+		setupBuffers(i);
 	}
-	
 }
 
 //===============================================================================
@@ -334,19 +410,16 @@ static int railIndices[] = {
 	14, 15, 12,
 };
 
-void ChunkMesh::addFence(int x, int y, int z) {
-	const int fix = Terrain::FENCE_TEX_INDEX + 1;
-	bool isFenceLeft = terrain->get(x-1, y, z) == fix;
-	bool isFenceRight = terrain->get(x+1, y, z) == fix;
-	bool isFenceBack = terrain->get(x, y, z-1) == fix;
-	bool isFenceFront = terrain->get(x, y, z+1) == fix;
+void ChunkMesh::addFence(int x, int y, int z, const BlockType &type) {
+	bool isFenceLeft = blockType(terrain->get(x-1, y, z)).mesh == BlockType::MESH_FENCE;
+	bool isFenceRight = blockType(terrain->get(x+1, y, z)).mesh == BlockType::MESH_FENCE;
+	bool isFenceBack = blockType(terrain->get(x, y, z-1)).mesh == BlockType::MESH_FENCE;
+	bool isFenceFront = blockType(terrain->get(x, y, z+1)).mesh == BlockType::MESH_FENCE;
 	
-	const int trow = 1;
-	const int tcol = 1;
-	TexCoordRect tcr(tcol * TEX_COORD_FACTOR, (tcol+1)*TEX_COORD_FACTOR, trow * TEX_COORD_FACTOR, (trow+1)*TEX_COORD_FACTOR);
+	TexCoordRect tcr = cellRect(type.tex[BlockType::TEX_SIDE]);
 	
 	PosTexVertexCol vx;
-	float brightness = daylightFactor * ((terrain->isBlockAbove(x, y, z)) ? 0.5f : 1.0f);
+	float brightness = getBrightness(terrain->getLight(x, y, z));
 	
 	// Add fence pillar
 	for(int i=0; i<6*6; i++) { // for each vertex
@@ -414,31 +487,25 @@ void ChunkMesh::addFence(int x, int y, int z) {
 //===============================================================================
 
 void ChunkMesh::processBlock(int x, int y, int z) {
-	int val = terrain->get(x, y, z) - 1;
-
-	if (val + 1 > 0 && !isInvisible(val + 1)) {
-		
-		if(val == Terrain::FENCE_TEX_INDEX) {
-			addFence(x, y, z);
-			return;
-		}
-		
-		VisibleFaces vfaces = terrain->determineVisibleFaces(x, y, z);
-		if (!vfaces.allInvisible()) {
-			addBlock(vfaces, x, y, z, val / NUM_TEX_PER_ROW, val % NUM_TEX_PER_ROW);
+	const BlockType &type = blockType(terrain->get(x, y, z));
+
+	switch (type.mesh) {
+		case BlockType::MESH_CUBE: {
+			VisibleFaces vfaces = visibleFaces(x, y, z);
+			if (!vfaces.allInvisible())
+				addBlock(vfaces, x, y, z, type);
+			break;
 		}
+		case BlockType::MESH_FENCE:
+			addFence(x, y, z, type);
+			break;
+		default:
+			break;
 	}
-
-}
-
-void ChunkMesh::addBlock(VisibleFaces vfaces, int x, int y, int z, int texRow, int texCol) {
-	TexCoordRect tcr(TEX_COORD_FACTOR * texCol, TEX_COORD_FACTOR * (texCol + 1),
-					 TEX_COORD_FACTOR * texRow, TEX_COORD_FACTOR * (texRow + 1));
-	addBlock(vfaces, x, y, z, &tcr);
 }
 
 inline void ChunkMesh::setBrightnessMacro(int x, int y, int z, float &brightness) const {
-	brightness = terrain->isBlockAbove(x, y, z) ? FAKE_SHADOW_BNESS : 1.0f;
+	brightness = getBrightness(terrain->getLight(x, y, z));
 }
 
 inline void ChunkMesh::frontBackMacro(float &brightness) const {
@@ -456,108 +523,80 @@ inline void ChunkMesh::bottomMacro(float &brightness) const {
 	//if(brightness < 0.0f) brightness = 0.0f;
 }
 
-void ChunkMesh::addBlock(VisibleFaces vfaces, int x, int y, int z, TexCoordRect *tcr) {
+// texture coordinates are generated for cell 0 and moved to each face's cell by genVx()
+void ChunkMesh::addBlock(VisibleFaces vfaces, int x, int y, int z, const BlockType &type) {
 	static float verts[TRANS_POS_NORM_VX_LEN];
-	genTranslatedPosTexNormalColVerticesFast((float)x, (float)y, (float)z, tcr, verts);
+	static TexCoordRect firstCell = cellRect(0);
+	genTranslatedPosTexNormalColVerticesFast((float)x, (float)y, (float)z, &firstCell, verts);
+
+	int sideCell = type.tex[vfaces.top ? BlockType::TEX_SIDE : BlockType::TEX_COVERED_SIDE];
 
-	// used for fake shadows (block on top of block adj to the face).
+	// light level of the cell in front of the face times the dimming of its direction
 	float brightness;
 
 	if (vfaces.front) {
 		setBrightnessMacro(x, y, z + 1, brightness);
 		frontBackMacro(brightness);		
-		genVx(verts, 0*COMPONENTS_PER_VERTEX_NOCOL, brightness);
-		genFace(false, true, vfaces.top);
+		genVx(verts, CF_FRONT, x, y, z, brightness, sideCell);
+		genFace();
 	}
 	if (vfaces.back) {
 		setBrightnessMacro(x, y, z - 1, brightness);
 		frontBackMacro(brightness);
-		genVx(verts, 4*COMPONENTS_PER_VERTEX_NOCOL, brightness);
-		genFace(false, true, vfaces.top);
+		genVx(verts, CF_BACK, x, y, z, brightness, sideCell);
+		genFace();
 	}
 	if (vfaces.left) {
 		setBrightnessMacro(x - 1, y, z, brightness);
 		leftRightMacro(brightness);
-		genVx(verts, 8*COMPONENTS_PER_VERTEX_NOCOL, brightness);
-		genFace(false, true, vfaces.top);
+		genVx(verts, CF_LEFT, x, y, z, brightness, sideCell);
+		genFace();
 	}
 	if (vfaces.right) {
 		setBrightnessMacro(x + 1, y, z, brightness);
 		leftRightMacro(brightness);
-		genVx(verts, 12*COMPONENTS_PER_VERTEX_NOCOL, brightness);
-		genFace(false, true, vfaces.top);
+		genVx(verts, CF_RIGHT, x, y, z, brightness, sideCell);
+		genFace();
 	}
 	if (vfaces.bottom) {
 		setBrightnessMacro(x, y - 1, z, brightness);
 		bottomMacro(brightness);
-		genVx(verts, 16*COMPONENTS_PER_VERTEX_NOCOL, brightness);
-		genFace(true, false, vfaces.top);
+		genVx(verts, CF_BOTTOM, x, y, z, brightness, type.tex[BlockType::TEX_BOTTOM]);
+		genFace();
 	}
 	if (vfaces.top) {
 		setBrightnessMacro(x, y + 1, z, brightness);
-		genVx(verts, 20*COMPONENTS_PER_VERTEX_NOCOL, brightness);
-		genFace(false, false, vfaces.top);
+		genVx(verts, CF_TOP, x, y, z, brightness, type.tex[BlockType::TEX_TOP]);
+		genFace();
 	}
 }
 
-void ChunkMesh::genFace(bool bottom, bool side, bool onTop) {
-	const float sideTexMinU = 0;
-	const float sideTexMaxU = TEX_COORD_FACTOR;
-	const float sideTexMinV = TEX_COORD_FACTOR;
-	const float sideTexMaxV = TEX_COORD_FACTOR * 2;
-
-	const float dirtTexMinU = TEX_COORD_FACTOR;
-	const float dirtTexMaxU = TEX_COORD_FACTOR * 2;
-	const float dirtTexMinV = 0;
-	const float dirtTexMaxV = TEX_COORD_FACTOR;
-
-	// first tex has side grass tex on sides!
-	bool specialBlock = (curVertices[0].u == 0 && curVertices[0].v == 0);
-
-	if (specialBlock && (side || bottom)) {
-		if (onTop && side) {
-			curVertices[0].u = sideTexMinU;
-			curVertices[0].v = sideTexMinV;
-			curVertices[1].u = sideTexMinU;
-			curVertices[1].v = sideTexMaxV;
-			curVertices[2].u = sideTexMaxU;
-			curVertices[2].v = sideTexMaxV;
-			curVertices[3].u = sideTexMaxU;
-			curVertices[3].v = sideTexMinV;
-		} else {
-			curVertices[0].u = dirtTexMinU;
-			curVertices[0].v = dirtTexMinV;
-			curVertices[1].u = dirtTexMinU;
-			curVertices[1].v = dirtTexMaxV;
-			curVertices[2].u = dirtTexMaxU;
-			curVertices[2].v = dirtTexMaxV;
-			curVertices[3].u = dirtTexMaxU;
-			curVertices[3].v = dirtTexMinV;
-		}
-	}
-	
+void ChunkMesh::genFace() {
+	// first vertex of the two triangles, keeps the winding either way
+	int first = flipQuad ? 1 : 0;
+
 #if INDEXED_CHK_MESH
 	int indexOffset = curIndex / COMPONENTS_PER_VERTEX;
-	ixBuf[curIxIndex++] = indexOffset+0;
-	ixBuf[curIxIndex++] = indexOffset+1;
-	ixBuf[curIxIndex++] = indexOffset+2;
+	ixBuf[curIxIndex++] = indexOffset+first;
+	ixBuf[curIxIndex++] = indexOffset+first+1;
+	ixBuf[curIxIndex++] = indexOffset+first+2;
 
-	ixBuf[curIxIndex++] = indexOffset+2;
-	ixBuf[curIxIndex++] = indexOffset+3;
-	ixBuf[curIxIndex++] = indexOffset+0;
+	ixBuf[curIxIndex++] = indexOffset+first+2;
+	ixBuf[curIxIndex++] = indexOffset+(first+3)%4;
+	ixBuf[curIxIndex++] = indexOffset+first;
 
 	pushCoords(&curVertices[0]);
 	pushCoords(&curVertices[1]);
 	pushCoords(&curVertices[2]);
 	pushCoords(&curVertices[3]);
 #else
-	pushCoords(&curVertices[0]);
-	pushCoords(&curVertices[1]);
-	pushCoords(&curVertices[2]);
+	pushCoords(&curVertices[first]);
+	pushCoords(&curVertices[first+1]);
+	pushCoords(&curVertices[first+2]);
 	
-	pushCoords(&curVertices[2]);
-	pushCoords(&curVertices[3]);
-	pushCoords(&curVertices[0]);
+	pushCoords(&curVertices[first+2]);
+	pushCoords(&curVertices[(first+3)%4]);
+	pushCoords(&curVertices[first]);
 #endif
 }
 
@@ -575,35 +614,30 @@ void ChunkMesh::pushCoords(PosTexVertexCol *vx) {
 	vxBuf[curIndex++] = 1.0f;
 }
 
-void ChunkMesh::genVx(float *verts, const uint offset, const float brightness) {
-	static float bness;
-	static float x, y, z;
-	static float ldist;
-	
+// brightness is the face's, each vertex is darkened by the blocks around it (ambient occlusion)
+void ChunkMesh::genVx(float *verts, CubeFace face, int x, int y, int z, float brightness, int texCell) {
+	const ulong offset = face * UNIQUE_VERTICES_PER_QUAD * COMPONENTS_PER_VERTEX_NOCOL;
+	float du = TEX_COORD_FACTOR * (texCell % NUM_TEX_PER_ROW);
+	float dv = TEX_COORD_FACTOR * (texCell / NUM_TEX_PER_ROW);
+	float ao[UNIQUE_VERTICES_PER_QUAD];
 	int j = 0;
 
-	// 11 components per vertex, 4 vertices per face
+	// 5 components per vertex, 4 vertices per face
 	for (ulong i = offset; i < offset + UNIQUE_VERTICES_PER_QUAD*COMPONENTS_PER_VERTEX_NOCOL; i += COMPONENTS_PER_VERTEX_NOCOL) {
-	
-		// the more adjacent blocks it has the darker a block gets		
-		bness = brightness * daylightFactor;
-
-		x = verts[i];
-		y = verts[i+1];
-		z = verts[i+2];
-
-		if (terrain->hasEntities()) {
-			ldist = terrain->distToNearestLight(x, y, z);
-			if (ldist <= MAX_LIGHT_DIST) {
-				float b = (1.0f - ldist*ldist / MAX_LIGHT_DIST * 0.25f);
-				if(b > bness) bness = b;
-			}
-		}
-
-		curVertices[j++] = PosTexVertexCol(x, y, z, // position coordinates
-			verts[i+3], verts[i+4], // texture coordinates u,v
+		const signed char (*n)[3] = AO_NEIGHBOURS[face][j];
+		int occluders = isOccupied(x + n[0][0], y + n[0][1], z + n[0][2])
+					  | isOccupied(x + n[1][0], y + n[1][1], z + n[1][2]) << 1
+					  | isOccupied(x + n[2][0], y + n[2][1], z + n[2][2]) << 2;
+		ao[j] = AO_BRIGHTNESS[occluders];
+
+		float bness = brightness * ao[j];
+		curVertices[j++] = PosTexVertexCol(verts[i], verts[i+1], verts[i+2], // position coordinates
+			verts[i+3] + du, verts[i+4] + dv, // texture coordinates u,v
 			bness, bness, bness); // color r,g,b
 	}
+
+	// split along the brighter diagonal, else a single dark corner bleeds into the opposite one
+	flipQuad = ao[0] + ao[2] < ao[1] + ao[3];
 }
 
 void ChunkMesh::renderBoundingBox() const {
@@ -625,7 +659,8 @@ void ChunkMesh::render(int camY) {
 			mesh->render();			
 		} else {
 			if(getTicks() - lastMeshInit > TICKS_BETWEEN_MESH_INITS) {
-				int j = meshes[camY / CHK_SUBMESH_HEIGHT] == NULL ? camY / CHK_SUBMESH_HEIGHT : i;
+				int camIndex = myMin(myMax(camY / CHK_SUBMESH_HEIGHT, 0), NUM_SUBMESHES - 1);
+				int j = meshes[camIndex] == NULL ? camIndex : i;
 				meshes[j] = new MeshType();
 				setupBuffers(j);
 				meshes[j]->render();
@@ -44,10 +44,11 @@ typedef Mesh MeshType;
 
 class ChunkMesh {
 public:
-	explicit ChunkMesh(Terrain *t, int minX = 0, int maxX = Terrain::MAX_X, int minZ = 0, int maxZ = Terrain::MAX_Z);
+	ChunkMesh(Terrain *t, int minX, int maxX, int minZ, int maxZ);
 	virtual ~ChunkMesh();
 
-	void update(int posY);
+	void update();
+	void update(const ChunkColumn::SectionMask &sections);
 
 	BoundingBox *getBoundingBox();
 	void renderBoundingBox() const;
@@ -61,22 +62,33 @@ public:
 	
 	enum Consts {
 		CHK_SUBMESH_HEIGHT	= Terrain::CHUNK_SIZE,
-		NUM_SUBMESHES		= Terrain::MAX_Y / CHK_SUBMESH_HEIGHT
+		NUM_SUBMESHES		= Terrain::MAX_Y / CHK_SUBMESH_HEIGHT,
+		// a submesh and the blocks around it
+		OCCUPANCY_EDGE		= Terrain::CHUNK_SIZE + 2
 	};
+
+	// a bit per block along x
+	typedef unsigned long long OccupancyRow;
+	static_assert(OCCUPANCY_EDGE <= 8 * sizeof(OccupancyRow), "chunks too wide for the occupancy rows");
 	
 	static bool updateDaylightFactor();
 	static float getDaylightFactor();
+	// of a face lit with light, see Terrain::getLight()
+	static float getBrightness(uchar light);
 	
 	static void reset();
 
 private:
 	void setupBuffers(int index);
 	void processBlock(int x, int y, int z);
-	void addFence(int x, int y, int z);
-	void addBlock(VisibleFaces vfaces, int x, int y, int z, int texRow, int texCol);
-	void addBlock(VisibleFaces vfaces, int x, int y, int z, TexCoordRect *tcr);
-	void genFace(bool bottom, bool side, bool onTop);
-	void genVx(float *verts, const uint offset, const float brightness);
+	void addFence(int x, int y, int z, const BlockType &type);
+	void addBlock(VisibleFaces vfaces, int x, int y, int z, const BlockType &type);
+	void genFace();
+	void genVx(float *verts, CubeFace face, int x, int y, int z, float brightness, int texCell);
+
+	void buildOccupancy(int minY);
+	bool isOccupied(int x, int y, int z) const;
+	VisibleFaces visibleFaces(int x, int y, int z) const;
 
 	void setBrightnessMacro(int x, int y, int z, float &brightness) const;
 	void frontBackMacro(float &brightness) const;
@@ -89,6 +101,13 @@ private:
 
 	std::list<PosTexVertexCol> vertices;
 	PosTexVertexCol curVertices[UNIQUE_VERTICES_PER_QUAD];
+	// split curVertices along 1-3 instead of 0-2
+	bool flipQuad;
+
+	// bit x - minX + 1 of occupancy[y - occupancyMinY + 1][z - minZ + 1] is set
+	// for blocks which cast a shadow (see Terrain::castsShadow())
+	OccupancyRow occupancy[OCCUPANCY_EDGE][OCCUPANCY_EDGE];
+	int occupancyMinY;
 
 	int minX, maxX, minZ, maxZ;
 
@@ -81,11 +81,11 @@ void EntityBatch::update() {
 			nx = nz = 0;
 		}
 
-		brightness = t->isBlockAbove(e->pos.x + nx, e->pos.y, e->pos.z + nz) ? 0.5f : 1.0f;
+		brightness = ChunkMesh::getBrightness(t->getLight(e->pos.x + nx, e->pos.y, e->pos.z + nz));
 
 		tcol = 8;
 		trow = 2 + e->type;
-		brightness = (e->type == Entity::TORCH) ? 1.0f : brightness * ChunkMesh::getDaylightFactor();
+		brightness = (e->type == Entity::TORCH) ? 1.0f : brightness;
 
 		if (e->type == Entity::FLOWER
 				|| (e->type == Entity::TORCH && e->cface == CF_TOP)
@@ -109,7 +109,7 @@ void EntityBatch::update() {
 			k = addQuadOnBlockFace(&e->pos, CF_FRONT, trow, tcol, cs, k, brightness, 0.0f, 1.0f, -1.0f);
 			k = addQuadOnBlockFace(&e->pos, CF_BACK, trow, tcol, cs, k, brightness, 0.0f, 1.0f, 0.0f);
 		} else if (e->type == Entity::GLASS) {
-			brightness = t->isBlockAbove(e->pos.x, e->pos.y, e->pos.z) ? 0.5f : 1.0f * ChunkMesh::getDaylightFactor();
+			brightness = ChunkMesh::getBrightness(t->getLight(e->pos.x, e->pos.y, e->pos.z));
 			k = addQuadOnBlockFace(&e->pos, CF_LEFT, trow, tcol, cs, k, brightness);
 			k = addQuadOnBlockFace(&e->pos, CF_RIGHT, trow, tcol, cs, k, brightness);
 			k = addQuadOnBlockFace(&e->pos, CF_TOP, trow, tcol, cs, k, brightness);
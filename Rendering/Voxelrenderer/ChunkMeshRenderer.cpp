@@ -25,7 +25,9 @@ ChunkMeshRenderer::ChunkMeshRenderer(Terrain *_t, RailManager *_rm, Camera *_cam
 		animalManager(_animalManager),
 		lastSceneUpdate(0),
 		startTicks(getTicks()),
-		camPosY(0)
+		camPosY(0),
+		lastCix(-1),
+		lastCiz(-1)
 {
 	if (visualDetail == DETAIL_VERY_LOW) {
 		gAdjChunkDist = 1;
@@ -50,21 +52,22 @@ ChunkMeshRenderer::ChunkMeshRenderer(Terrain *_t, RailManager *_rm, Camera *_cam
 	reset();
 	
 	if(keepMeshes) {
-		for (int x = 0; x < NUM_CHUNKS_X_Z; x++) {
-			for (int z = 0; z < NUM_CHUNKS_X_Z; z++) {
-				allocateChunk(x, z);
+		for (int x = lastCix - ADJ_CHUNK_DIST; x <= lastCix + ADJ_CHUNK_DIST; x++) {
+			for (int z = lastCiz - ADJ_CHUNK_DIST; z <= lastCiz + ADJ_CHUNK_DIST; z++) {
+				if (x >= 0 && z >= 0 && !findChunk(x, z))
+					allocateChunk(x, z);
 			}
 		}
 	}
 }
 	
 void ChunkMeshRenderer::freeAllMeshes() {
-	for (int x = 0; x < NUM_CHUNKS_X_Z; x++) {
-		for (int z = 0; z < NUM_CHUNKS_X_Z; z++) {
-			SAFE_DELETE(chunkMeshes[x][z]);
-			SAFE_DELETE(entityBatches[x][z]);
-		}
+	RenderChunkMap::iterator it;
+	for (it = chunks.begin(); it != chunks.end(); ++it) {
+		SAFE_DELETE(it->second.mesh);
+		SAFE_DELETE(it->second.entities);
 	}
+	chunks.clear();
 }
 
 ChunkMeshRenderer::~ChunkMeshRenderer() {
@@ -73,74 +76,69 @@ ChunkMeshRenderer::~ChunkMeshRenderer() {
 
 void ChunkMeshRenderer::reset() {
 	Vec3 camPos = cam->getPos();
-	memset(chunkMeshes, 0, sizeof(ChunkMesh *) * NUM_CHUNKS_X_Z * NUM_CHUNKS_X_Z);
-	memset(entityBatches, 0, sizeof(EntityBatch *) * NUM_CHUNKS_X_Z * NUM_CHUNKS_X_Z);
+	chunks.clear();
+	lastCix = lastCiz = -1;
 	lastSceneUpdate = 0;
 	update(&camPos);
 }
 
-inline void ChunkMeshRenderer::addDirtyChkNoDups(int cmx, int cmz, int changedPosY) {
-	if (!chunkAlreadyDirty(cmx, cmz, t->isEntityUpdate())) {
-		dirtyChunks.push_back(ScheduledChunk(cmx, cmz, t->isEntityUpdate(), changedPosY));
-	}
+inline void ChunkMeshRenderer::markDirty(int cmx, int cmz, const ChunkColumn::SectionMask &sections) {
+	DirtyChunk &chk = dirtyChunks[ChunkColumn::makeKey(cmx, cmz)];
+	chk.x = cmx;
+	chk.z = cmz;
+
+	if (t->isEntityUpdate())
+		chk.entities = true;
+	else
+		chk.sections |= sections;
 }
 
 // terrain changed (buffer this, because it is expensive!)
 void ChunkMeshRenderer::update(BlockPos *bposChanged) {
 	// chunk containing the changed terrain
-	int cmx = (int)((float)bposChanged->x / (float)CHUNK_X_SIZE);
-	int cmz = (int)((float)bposChanged->z / (float)CHUNK_Z_SIZE);
+	int cmx = bposChanged->x >> Terrain::CHUNK_SHIFT;
+	int cmz = bposChanged->z >> Terrain::CHUNK_SHIFT;
 
-	addDirtyChkNoDups(cmx, cmz, bposChanged->y);
+	ChunkColumn::SectionMask section;
+	section.set(bposChanged->y >> Terrain::CHUNK_SHIFT);
+
+	// edit batches already report every section a change touched
+	if (t->isSectionUpdate()) {
+		markDirty(cmx, cmz, section);
+		return;
+	}
+
+	markDirty(cmx, cmz, ChunkColumn::sectionsAround(bposChanged->y));
 
 	int dmx, dmz;
-	dmx = bposChanged->x % CHUNK_X_SIZE;
-	dmz = bposChanged->z % CHUNK_Z_SIZE;
+	dmx = bposChanged->x & Terrain::CHUNK_MASK;
+	dmz = bposChanged->z & Terrain::CHUNK_MASK;
 
 	// also update adjacent ones if we're on the edge
-	if (dmx == 0 && cmx > 0) {
-		addDirtyChkNoDups(cmx - 1, cmz);
-	} else if (dmx == CHUNK_X_SIZE - 1 && cmx + 1 < Terrain::MAX_X / CHUNK_X_SIZE) {
-		addDirtyChkNoDups(cmx + 1, cmz);
+	if (dmx == 0) {
+		markDirty(cmx - 1, cmz, section);
+	} else if (dmx == CHUNK_X_SIZE - 1) {
+		markDirty(cmx + 1, cmz, section);
 	}
-	if (dmz == 0 && cmz > 0) {
-		addDirtyChkNoDups(cmx, cmz - 1);
-	} else if (dmz == CHUNK_Z_SIZE - 1 && cmz + 1 < Terrain::MAX_Z / CHUNK_Z_SIZE) {
-		addDirtyChkNoDups(cmx, cmz + 1);
-	}
-}
-
-bool ChunkMeshRenderer::chunkAlreadyDirty(int cmx, int cmz, bool entityUpdate) {
-	static std::list<ScheduledChunk>::iterator it;
-	static ScheduledChunk *chk;
-
-	for (it = dirtyChunks.begin(); it != dirtyChunks.end(); ++it) {
-		chk = &(*it);
-		if (chk->x == cmx && chk->z == cmz && chk->entityUpdate == entityUpdate) {
-			return true;
-		}
+	if (dmz == 0) {
+		markDirty(cmx, cmz - 1, section);
+	} else if (dmz == CHUNK_Z_SIZE - 1) {
+		markDirty(cmx, cmz + 1, section);
 	}
-
-	return false;
 }
 
 void ChunkMeshRenderer::flushChunkUpdates() {
-	static std::list<ScheduledChunk>::iterator it;
-	static ScheduledChunk *chk;
-	static int cmx, cmz;
-
+	DirtyChunkMap::iterator it;
 	for (it = dirtyChunks.begin(); it != dirtyChunks.end(); ++it) {
-		chk = &(*it);
-		cmx = chk->x;
-		cmz = chk->z;
+		DirtyChunk *chk = &it->second;
+		RenderChunk *chunk = findChunk(chk->x, chk->z);
 
-		if (!chunkMeshes[cmx][cmz] || !entityBatches[cmx][cmz]) return;
+		if (!chunk) continue;
 
-		if (chk->entityUpdate) {
-			entityBatches[cmx][cmz]->update();
-		} else {
-			chunkMeshes[cmx][cmz]->update(chk->changedPosY);
-		}
+		if (chk->entities)
+			chunk->entities->update();
+		if (chk->sections.any())
+			chunk->mesh->update(chk->sections);
 	}
 
 	dirtyChunks.clear();
@@ -153,8 +151,34 @@ inline void ChunkMeshRenderer::allocateChunk(int x, int z) {
 	int minZ = z * CHUNK_Z_SIZE;
 	int maxZ = (z + 1) * CHUNK_Z_SIZE;
 
-	chunkMeshes[x][z] = new ChunkMesh(t, minX, maxX, minZ, maxZ);
-	entityBatches[x][z] = new EntityBatch(t, rm, minX, maxX, minZ, maxZ);
+	RenderChunk &chunk = chunks[ChunkColumn::makeKey(x, z)];
+	chunk.x = x;
+	chunk.z = z;
+	chunk.mesh = new ChunkMesh(t, minX, maxX, minZ, maxZ);
+	chunk.entities = new EntityBatch(t, rm, minX, maxX, minZ, maxZ);
+}
+
+inline void ChunkMeshRenderer::freeChunk(RenderChunk *chunk) {
+	SAFE_DELETE(chunk->mesh);
+	SAFE_DELETE(chunk->entities);
+	chunks.erase(ChunkColumn::makeKey(chunk->x, chunk->z));
+}
+
+// drop chunks the ring in update(Vec3*) can't reach anymore (e.g. after teleporting)
+void ChunkMeshRenderer::freeFarChunks(int cix, int ciz) {
+	int keepDist = ADJ_CHUNK_DIST + 1;
+	if (keepMeshes)
+		keepDist += Terrain::EVICT_MARGIN;
+
+	RenderChunkMap::iterator it;
+	for (it = chunks.begin(); it != chunks.end();) {
+		RenderChunk *chunk = &it->second;
+		if (ABS(chunk->x - cix) > keepDist || ABS(chunk->z - ciz) > keepDist) {
+			SAFE_DELETE(chunk->mesh);
+			SAFE_DELETE(chunk->entities);
+			chunks.erase(it++);
+		} else ++it;
+	}
 }
 
 // Execute scheduled allocations and frees
@@ -173,8 +197,9 @@ void ChunkMeshRenderer::updateChunks(int cix, int ciz) {
 		int x = (*it).x;
 		int z = (*it).z;
 
-		// adding duplicates is faster than checking for them.
-		if (!chunkMeshes[x][z] && chunkIsAdjacent(x, z, cix, ciz)) {
+		// adding duplicates is faster than checking for them. Chunks whose columns
+		// aren't all resident yet are scheduled again once they are
+		if (!findChunk(x, z) && chunkIsAdjacent(x, z, cix, ciz) && t->hasColumnsAround(x, z)) {
 			allocateChunk(x, z);
 			numChangedChunks++;
 		}
@@ -189,9 +214,9 @@ void ChunkMeshRenderer::updateChunks(int cix, int ciz) {
 		int z = (*it).z;
 
 		// adding duplicates is faster than checking for them.
-		if (chunkMeshes[x][z] && !chunkIsAdjacent(x, z, cix, ciz)) {
-			SAFE_DELETE(chunkMeshes[x][z]);
-			SAFE_DELETE(entityBatches[x][z]);
+		RenderChunk *chunk = findChunk(x, z);
+		if (chunk && !chunkIsAdjacent(x, z, cix, ciz)) {
+			freeChunk(chunk);
 			numChangedChunks++;
 		}
 
@@ -199,9 +224,10 @@ void ChunkMeshRenderer::updateChunks(int cix, int ciz) {
 	}
 }
 
-inline void ChunkMeshRenderer::tryToRenderChunk(int x, int z) const {
-	if (chunkMeshes[x][z]) {
-		chunkMeshes[x][z]->render(camPosY);
+inline void ChunkMeshRenderer::tryToRenderChunk(int x, int z) {
+	RenderChunk *chunk = findChunk(x, z);
+	if (chunk) {
+		chunk->mesh->render(camPosY);
 	}
 }
 	
@@ -210,12 +236,8 @@ void ChunkMeshRenderer::updateDaylight() {
 	//const ticks_t DAYLIGHT_UPDATE_TICKS = 500;
 	
 	if(ChunkMesh::updateDaylightFactor()) {
-		for(int x=0; x<NUM_CHUNKS_X_Z; x++) {
-			for(int z=0; z<NUM_CHUNKS_X_Z; z++) {
-				if(chunkMeshes[x][z]) {
-					scheduledDaylightUpdates.push(ChunkIndex(x, z));
-				}
-			}
+		for(RenderChunkMap::iterator it = chunks.begin(); it != chunks.end(); ++it) {
+			scheduledDaylightUpdates.push(ChunkIndex(it->second.x, it->second.z));
 		}
 		
 		AnimalManager::setupAnimalMeshes(ChunkMesh::getDaylightFactor());
@@ -223,13 +245,12 @@ void ChunkMeshRenderer::updateDaylight() {
 	
 	if(!scheduledDaylightUpdates.empty() && getTicks() - lastUpdate > ticksBetweenChunkUpdates) {
 		ChunkIndex chunkIndex = scheduledDaylightUpdates.front();
-		int x = chunkIndex.x;
-		int z = chunkIndex.z;
+		RenderChunk *chunk = findChunk(chunkIndex.x, chunkIndex.z);
 		
-		if(chunkMeshes[x][z])
-			chunkMeshes[x][z]->update(-1);
-		if(entityBatches[x][z])
-			entityBatches[x][z]->update();
+		if(chunk) {
+			chunk->mesh->update();
+			chunk->entities->update();
+		}
 		
 		scheduledDaylightUpdates.pop();
 		lastUpdate = getTicks();
@@ -250,41 +271,41 @@ void ChunkMeshRenderer::render() {
 	cy = (int)camPos->y;
 	cz = (int)camPos->z;
 
-	cix = cx / CHUNK_X_SIZE;
-	ciz = cz / CHUNK_Z_SIZE;
+	cix = cx >> Terrain::CHUNK_SHIFT;
+	ciz = cz >> Terrain::CHUNK_SHIFT;
+
+	// the rest of the requested columns, a few per frame
+	if (t->hasPendingColumns() && t->streamColumns(COLUMNS_PER_FRAME) > 0 && cix >= 0 && ciz >= 0)
+		scheduleChunks(cix, ciz);
 
 	updateChunks(cix, ciz);
 
 	frustum.update();
 
-	std::list<ScheduledChunk> ebToDraw;
+	std::list<RenderChunk *> ebToDraw;
 	//ebToDraw.clear();
 
-	for (int x = 0; x < NUM_CHUNKS_X_Z; x++) {
-		for (int z = 0; z < NUM_CHUNKS_X_Z; z++) {
-			if (!chunkMeshes[x][z] || !chunkIsAdjacent(x, z, cix, ciz))
-				continue;
+	for (RenderChunkMap::iterator it = chunks.begin(); it != chunks.end(); ++it) {
+		RenderChunk *chunk = &it->second;
+		if (!chunkIsAdjacent(chunk->x, chunk->z, cix, ciz))
+			continue;
 
-			BoundingBox* bbox = chunkMeshes[x][z]->getBoundingBox();
+		BoundingBox* bbox = chunk->mesh->getBoundingBox();
 
-			if (camInBox(bbox) || frustum.boxInFrustum(bbox)) {
-				chunkMeshes[x][z]->render(camPosY);
-				ebToDraw.push_back(ScheduledChunk(x, z, true));
-				animalManager->renderAnimalsInChk(x, z);				
-			}
+		if (camInBox(bbox) || frustum.boxInFrustum(bbox)) {
+			chunk->mesh->render(camPosY);
+			ebToDraw.push_back(chunk);
+			animalManager->renderAnimalsInChk(chunk->x, chunk->z);
 		}
 	}
 
-	static ScheduledChunk *eb;
-
 	if (!ebToDraw.empty()) {
 		glEnable(GL_ALPHA_TEST);
 		glEnable(GL_BLEND);
 	}
 
-	for (std::list<ScheduledChunk>::iterator it = ebToDraw.begin(); it != ebToDraw.end(); ++it) {
-		eb = &(*it);
-		entityBatches[eb->x][eb->z]->render();
+	for (std::list<RenderChunk *>::iterator it = ebToDraw.begin(); it != ebToDraw.end(); ++it) {
+		(*it)->entities->render();
 	}
 
 	if (!ebToDraw.empty()) {
@@ -294,47 +315,64 @@ void ChunkMeshRenderer::render() {
 }
 
 inline void ChunkMeshRenderer::allocateIfNeeded(int x, int z) {
-	if (!chunkMeshes[x][z]) {
-		toAllocate.push_back(ScheduledChunk(x, z, false));
+	if (!findChunk(x, z)) {
+		toAllocate.push_back(ScheduledChunk(x, z));
 	}
 }
 
 inline void ChunkMeshRenderer::freeIfNeeded(int x, int z) {
-	if (chunkMeshes[x][z]) {
-		toFree.push_back(ScheduledChunk(x, z, false));
+	if (findChunk(x, z)) {
+		toFree.push_back(ScheduledChunk(x, z));
 	}
 }
 
 inline void ChunkMeshRenderer::manageChunk(int x, int z, int k) {
-	if (x < 0 || z < 0 || x >= NUM_CHUNKS_X_Z || z >= NUM_CHUNKS_X_Z) {
+	if (x < 0 || z < 0) {
 		return;
 	}
 
 	if (k <= ADJ_CHUNK_DIST) {
 		allocateIfNeeded(x, z);
-	} else {
+	} else if (!keepMeshes) {
 		freeIfNeeded(x, z);
 	}
 }
 
 // Shedule allocation/frees on camera movement
 void ChunkMeshRenderer::update(Vec3 *newCamPos) {
-	if(keepMeshes)
-		return;
-
 	static int cix, ciz;
 	
 	camPosY = (int)newCamPos->y;
 
-	cix = (int)newCamPos->x / CHUNK_X_SIZE;
-	ciz = (int)newCamPos->z / CHUNK_Z_SIZE;
+	cix = (int)newCamPos->x >> Terrain::CHUNK_SHIFT;
+	ciz = (int)newCamPos->z >> Terrain::CHUNK_SHIFT;
 
-	if (cix < 0 || ciz < 0 || cix > (NUM_CHUNKS_X_Z + 1) * CHUNK_X_SIZE || ciz > (NUM_CHUNKS_X_Z + 1) * CHUNK_Z_SIZE) {
+	if (cix < 0 || ciz < 0) {
 		return;
 	}
 
+	// stream terrain columns whenever the camera enters another chunk,
+	// render() loads them over the next frames
+	if (cix != lastCix || ciz != lastCiz) {
+		if (lastCix < 0) {
+			t->loadColumnsAround(cix, ciz, ADJ_CHUNK_DIST + 1);
+		} else {
+			t->requestColumnsAround(cix, ciz, ADJ_CHUNK_DIST + 1);
+			// e.g. after teleporting, the ground around the camera is needed right away
+			if (!t->hasColumnsAround(cix, ciz))
+				t->streamColumns(3 * 3);
+		}
+		freeFarChunks(cix, ciz);
+		lastCix = cix;
+		lastCiz = ciz;
+	}
+
+	scheduleChunks(cix, ciz);
+}
+
+void ChunkMeshRenderer::scheduleChunks(int cix, int ciz) {
 	// always make sure chunk containing cam is allocated
-	if (!chunkMeshes[cix][ciz]) {
+	if (!findChunk(cix, ciz) && t->hasColumnsAround(cix, ciz)) {
 		allocateChunk(cix, ciz);
 	}
 
@@ -5,6 +5,7 @@
 
 #include <list>
 #include <queue>
+#include <unordered_map>
 
 #include "../../Terrain.hpp"
 
@@ -28,23 +29,21 @@ class SkyMesh;
 class ScheduledChunk {
 public:
 	int x, z;
-	bool entityUpdate;
-	int changedPosY;
 
-	ScheduledChunk(int _x, int _z, bool _entityUpdate, int _changedPosY = -1)
-	: x(_x), z(_z), entityUpdate(_entityUpdate), changedPosY(_changedPosY) {}
+	ScheduledChunk(int _x, int _z) : x(_x), z(_z) {}
 
 	bool operator==(const ScheduledChunk &other) const {
 		return x == other.x && z == other.z;
 	}
 };
 
-class DirtyChunk : public ScheduledChunk {
-public:
-	int dmx, dmz;
+// pending mesh work of one chunk, coalesced until the next flush
+struct DirtyChunk {
+	int x, z;
+	bool entities;
+	ChunkColumn::SectionMask sections;
 
-	DirtyChunk(int _x, int _z, int _dmx, int _dmz, bool _entityUpdate)
-	: ScheduledChunk(_x, _z, _entityUpdate), dmx(_dmx), dmz(_dmz) {}
+	DirtyChunk() : x(0), z(0), entities(false) {}
 };
 
 struct ChunkIndex {
@@ -53,6 +52,12 @@ struct ChunkIndex {
 	ChunkIndex(int _x, int _z) : x(_x), z(_z) {}
 };
 
+struct RenderChunk {
+	int x, z;
+	ChunkMesh *mesh;
+	EntityBatch *entities;
+};
+
 class ChunkMeshRenderer : public IVoxelRenderer, Observer<Vec3> {
 public:
 	ChunkMeshRenderer(Terrain *t, RailManager *rm, Camera *cam, AnimalManager *animalManager);
@@ -65,8 +70,7 @@ public:
 	
 	enum ChunkDimensions {
 		CHUNK_X_SIZE = Terrain::CHUNK_SIZE,
-		CHUNK_Z_SIZE = Terrain::CHUNK_SIZE,
-		NUM_CHUNKS_X_Z = Terrain::TERRAIN_SIZE / Terrain::CHUNK_SIZE
+		CHUNK_Z_SIZE = Terrain::CHUNK_SIZE
 	};
 
 private:
@@ -75,34 +79,39 @@ private:
 	void renderNonOccluded();
 	void reset();
 	void updateChunks(int cix, int ciz);
+	void scheduleChunks(int cix, int ciz);
 	void setupSeaPlane();
 
-	bool chunkAlreadyDirty(int cmx, int cmz, bool entityUpdate);
-
 	void flushChunkUpdates();
 
+	RenderChunk *findChunk(int x, int z);
 	void allocateChunk(int x, int z);
-	void tryToRenderChunk(int x, int z) const;
+	void freeChunk(RenderChunk *chunk);
+	void freeFarChunks(int cix, int ciz);
+	void tryToRenderChunk(int x, int z);
 
 	void allocateIfNeeded(int x, int z);
 	void freeIfNeeded(int x, int z);
 	void manageChunk(int x, int z, int k);
 
-	void addDirtyChkNoDups(int cmx, int cmz, int changedPosY = -1);
+	void markDirty(int cmx, int cmz, const ChunkColumn::SectionMask &sections);
 	
 	void freeAllMeshes();
 	
 	void updateDaylight();
 	
-	ChunkMesh *chunkMeshes[NUM_CHUNKS_X_Z][NUM_CHUNKS_X_Z];
-	EntityBatch *entityBatches[NUM_CHUNKS_X_Z][NUM_CHUNKS_X_Z];
+	typedef std::unordered_map<ChunkKey, RenderChunk, ChunkKeyHash> RenderChunkMap;
+	RenderChunkMap chunks;
 
 	Terrain *t;
 	RailManager *rm;
 	Camera *cam;
 	Frustum &frustum;
 
-	std::list<ScheduledChunk> toAllocate, toFree, dirtyChunks;
+	std::list<ScheduledChunk> toAllocate, toFree;
+
+	typedef std::unordered_map<ChunkKey, DirtyChunk, ChunkKeyHash> DirtyChunkMap;
+	DirtyChunkMap dirtyChunks;
 	std::queue<ChunkIndex> scheduledDaylightUpdates;
 
 	AnimalManager *animalManager;
@@ -111,14 +120,22 @@ private:
 	ticks_t startTicks;
 	
 	int camPosY;
+	int lastCix, lastCiz;
 	
 	enum Consts {
 		MAX_CHUNK_UPDATES = 1,
+		// terrain columns streamed in per frame
+		COLUMNS_PER_FRAME = 4,
 		EDGE_DIST = 2,
 		WORLD_EDGE_DIST = 2
 	};
 };
 
+inline RenderChunk *ChunkMeshRenderer::findChunk(int x, int z) {
+	RenderChunkMap::iterator it = chunks.find(ChunkColumn::makeKey(x, z));
+	return (it != chunks.end()) ? &it->second : NULL;
+}
+
 inline bool ChunkMeshRenderer::chunkIsAdjacent(int chunkX, int chunkZ, int camX, int camZ) const {
 	return (chunkX >= camX - ADJ_CHUNK_DIST && chunkX <= camX + ADJ_CHUNK_DIST
 			&& chunkZ >= camZ - ADJ_CHUNK_DIST && chunkZ <= camZ + ADJ_CHUNK_DIST);
@@ -27,6 +27,8 @@
 #include "../Managers/NetManager.hpp"
 #include "../Managers/RailManager.hpp"
 
+#include "../Framework/ByteBuffer.hpp"
+
 #include "../Terrain.hpp"
 #include "../Movement.hpp"
 #include "../InputMethods.hpp"
@@ -66,6 +68,8 @@ bool survival = false;
 
 bool mouseWasReleased = false;
 
+int autosaveInterval = 60;
+
 // Toggles
 bool noNight = false;
 bool noAnimals = false;
@@ -82,17 +86,39 @@ inline void LandscapeScene::saveWorld() {
 #endif
 	char saveFilename[BUF_LEN];
 	std::sprintf(saveFilename, "World%d.dump", worldNum);
-	terrain->saveTerrainToFile(saveFilename);
-	terrain->saveEntitiesToFile(saveFilename);
-	savePosToFile(saveFilename);
-	animalManager->saveToFile(saveFilename);
+
+	// copy the world state now, write it without stalling the game
+	WorldSnapshot *snapshot = new WorldSnapshot();
+	terrain->addTerrainToSnapshot(snapshot, saveFilename);
+	terrain->addEntitiesToSnapshot(snapshot);
+	addPosToSnapshot(snapshot);
+	animalManager->addToSnapshot(snapshot);
 	// TODO: Save survival mode stuff here too
+	terrain->writeInBackground(snapshot);
+	lastSaveTicks = getTicks();
+}
+
+// never waits for a running save; edits until the next autosave are written together
+void LandscapeScene::autosave() {
+	if (autosaveInterval <= 0 || getTicks() - lastSaveTicks < (ticks_t)autosaveInterval * 1000)
+		return;
+#if !NO_NET
+	if (netManager && !netManager->shouldSave())
+		return;
+#endif
+	if (terrain->isSaving())
+		return;
+
+	if (terrain->hasUnsavedChanges())
+		saveWorld();
+	else
+		lastSaveTicks = getTicks();
 }
 
 LandscapeScene::LandscapeScene(const char *filename, StateManager *_g, bool mp, bool server)
 :	g(_g),
 	netManager(NULL),
-	cam(FOV, Vec3(Terrain::MAX_X / 2.0f + 0.5f, Terrain::MAX_Y + 5, Terrain::MAX_Z / 2.0f + 0.5f), Vec3(0, 0, 1), Vec3(0, 1, 0))
+	cam(FOV, Vec3(Terrain::WORLD_CENTER + 0.5f, Terrain::MAX_Y + 5, Terrain::WORLD_CENTER + 0.5f), Vec3(0, 0, 1), Vec3(0, 1, 0))
 {
 	commonInit(0, filename, Terrain::TS_FILE, mp, server);
 }
@@ -100,7 +126,7 @@ LandscapeScene::LandscapeScene(const char *filename, StateManager *_g, bool mp,
 LandscapeScene::LandscapeScene(int seed, StateManager *_g, Terrain::TerrainSource tsource, bool mp, bool server)
 :	g(_g),
 	netManager(NULL),
-	cam(FOV, Vec3(Terrain::MAX_X / 2.0f + 0.5f, Terrain::MAX_Y + 5, Terrain::MAX_Z / 2.0f + 0.5f), Vec3(0, 0, 1), Vec3(0, 1, 0))
+	cam(FOV, Vec3(Terrain::WORLD_CENTER + 0.5f, Terrain::MAX_Y + 5, Terrain::WORLD_CENTER + 0.5f), Vec3(0, 0, 1), Vec3(0, 1, 0))
 {
 	commonInit(seed, NULL, tsource, mp, server);
 }
@@ -108,7 +134,9 @@ LandscapeScene::LandscapeScene(int seed, StateManager *_g, Terrain::TerrainSourc
 LandscapeScene::~LandscapeScene() {
 #if !NO_NET
 	if (!netManager || netManager->shouldSave())
+#endif
 		saveWorld();
+#if !NO_NET
 	SAFE_DELETE(netManager);
 #endif
 
@@ -116,6 +144,7 @@ LandscapeScene::~LandscapeScene() {
 
 	SAFE_DELETE(animalManager);
 	SAFE_DELETE(tntManager);
+	SAFE_DELETE(fluidManager);
 	SAFE_DELETE(railManager);
 
 	SAFE_DELETE(mvmt);
@@ -127,8 +156,8 @@ LandscapeScene::~LandscapeScene() {
 void LandscapeScene::persist() {
 #if !NO_NET
 	if(!netManager || netManager->shouldSave())
-		saveWorld();
 #endif
+		saveWorld();
 }
 
 void LandscapeScene::commonInit(int seed, const char *filename, Terrain::TerrainSource tsource, bool mp, bool server) {
@@ -137,25 +166,42 @@ void LandscapeScene::commonInit(int seed, const char *filename, Terrain::Terrain
 	posArray[0] = posArray[1] = posArray[2] = -1;
 	sx = sy = worldNum = -1;
 
-	lastCamPos.setTo(cam.getPosPtr());
-	lastCamNormal.setTo(cam.getNormalPtr());
-
 	texSelOverlayActive = texSelOverlayFinished = false;
 
 	digMode = true;
 
 	selectedTexture = (survival ? HAND_TEX_INDEX : 0);
 	lastTexSwitch = lastBlockPlacementTicks = 0;
+	lastSaveTicks = getTicks();
+
+	WorldFile worldFile;
+	bool hasWorldFile = filename && worldFile.load(filename);
 
 	if (!filename) {
 		terrain = new Terrain(tsource, seed);
 		worldNum = determineNextFreeSlot();
+
+		// columns streamed out of memory are saved next to the world file right away
+		char saveFilename[BUF_LEN];
+		std::sprintf(saveFilename, "World%d.dump", worldNum);
+		terrain->saveTerrainToFile(saveFilename);
 	} else {
 		terrain = new Terrain(Terrain::TS_EMPTY, (int)std::time(NULL));
-		terrain->loadTerrainFromFile(filename);
-		terrain->loadEntitiesFromFile(filename);
+		if (hasWorldFile) {
+			terrain->loadTerrain(worldFile, filename);
+			terrain->loadEntities(worldFile);
+		} else {
+			terrain->loadTerrainFromFile(filename);
+			terrain->loadEntitiesFromFile(filename);
+		}
 		std::sscanf(filename, "World%d.dump", &worldNum);
-		if (tryLoadPosFromFile(filename)) {
+	}
+
+	cam.getPosPtr()->x = terrain->getSpawnX() + 0.5f;
+	cam.getPosPtr()->z = terrain->getSpawnZ() + 0.5f;
+
+	if (filename) {
+		if (hasWorldFile ? tryLoadPos(worldFile) : tryLoadPosFromFile(filename)) {
 			cam.getPosPtr()->x = (float)posArray[0]; // x
 			cam.getPosPtr()->y = (float)posArray[1]; // y
 			cam.getPosPtr()->z = (float)posArray[2]; // z
@@ -167,7 +213,9 @@ void LandscapeScene::commonInit(int seed, const char *filename, Terrain::Terrain
 #endif
 
 	animalManager = new AnimalManager(&cam, terrain);
-	if(filename) {
+	if (hasWorldFile) {
+		animalManager->loadAnimals(worldFile);
+	} else if(filename) {
 		animalManager->loadFromFile(filename);
 	}
 
@@ -180,10 +228,11 @@ void LandscapeScene::commonInit(int seed, const char *filename, Terrain::Terrain
 
 	hudRenderer = new HudRenderer(terrain, &cam, animalManager);
 
-	nearBlocksDirty = true;
-
 	tntManager = new TNTManager(landscapeRenderer, terrain);
 
+	fluidManager = new FluidManager(terrain);
+	terrain->addObserver(fluidManager);
+
 	highlightSelBlock = !MOBILE || activeInputMethod == IM_PC;
 
 	glClearColor(0.6289f, 0.6953f, 0.9f, 1.0f);
@@ -199,10 +248,20 @@ void LandscapeScene::commonInit(int seed, const char *filename, Terrain::Terrain
 	}
 
 	crouching = false;
+	undoKeyDown = false;
 	
 	touchWasReleased = false;
 }
 
+bool LandscapeScene::tryLoadPos(const WorldFile &file) {
+	const std::vector<uchar> &data = file.getSection(WorldFile::SEC_PLAYER);
+	ByteReader r(data.data(), data.size());
+	for (int i = 0; i < 3; i++) {
+		posArray[i] = r.getInt();
+	}
+	return r.ok() && posArray[0] != -1 && posArray[1] != -1 && posArray[2] != -1;
+}
+
 bool LandscapeScene::tryLoadPosFromFile(const char *filename) {
 	DET_POS_FILE(filename);
 	if (fileExists(posFilename)) {
@@ -211,12 +270,17 @@ bool LandscapeScene::tryLoadPosFromFile(const char *filename) {
 	return (posArray[0] != -1 && posArray[1] != -1 && posArray[2] != -1);
 }
 
-void LandscapeScene::savePosToFile(const char *filename) {
-	DET_POS_FILE(filename);
+void LandscapeScene::addPosToSnapshot(WorldSnapshot *snapshot) {
 	posArray[0] = (int)cam.getPosPtr()->x; // x
 	posArray[1] = (int)cam.getPosPtr()->y; // y
 	posArray[2] = (int)cam.getPosPtr()->z; // z
-	binaryWrite(posFilename, posArray, sizeof(int) * 3);
+
+	std::vector<uchar> data;
+	ByteWriter w(&data);
+	for (int i = 0; i < 3; i++) {
+		w.putInt(posArray[i]);
+	}
+	snapshot->getFile().setSection(WorldFile::SEC_PLAYER, &data);
 }
 
 void LandscapeScene::processKeyboardInput(bool *keys, SDLMod mod, ticks_t delta) {
@@ -273,17 +337,25 @@ void LandscapeScene::processKeyboardInput(bool *keys, SDLMod mod, ticks_t delta)
 	if (keys[KEY_F])
 		mvmt->toggleFlyMode();
 
+	// only our own edits are journaled, the other player wouldn't see them undone.
+	// Z alone is too close to the movement keys
+	bool undoKey = keys[KEY_SHORTCUT] && (keys[KEY_Z] || keys[KEY_Y]);
+	if (undoKey && !undoKeyDown && !netManager) {
+		if (keys[KEY_Z])
+			terrain->undo();
+		else
+			terrain->redo();
+	}
+	undoKeyDown = undoKey;
+
 #endif
 }
 
-inline float LandscapeScene::calcDistToSelBlock() {
-	float distToSelBlock = FLT_MAX;
-	BlockPos *selBlock = landscapeRenderer->getSelectedBlock();
-	if(selBlock) {
-		Vec3 sbpos((float)selBlock->x, (float)selBlock->y, (float)selBlock->z);
-		distToSelBlock = (cam.getPos() - sbpos).length();
-	}
-	return distToSelBlock;
+// along the same pick ray as AnimalManager::tryToHitAnimal()
+inline float LandscapeScene::calcDistToSelBlock(int x, int y) {
+	Ray ray = cam.getPickRay(x, y);
+	BlockHit hit;
+	return terrain->raycast(ray.origin, ray.direction, (float)nearDist, &hit) ? hit.dist : FLT_MAX;
 }
 
 void LandscapeScene::processMouseInput(int dX, int dY, int wheel, MouseButtons *mb, ticks_t delta) {
@@ -304,7 +376,7 @@ void LandscapeScene::processMouseInput(int dX, int dY, int wheel, MouseButtons *
 			if (mouseWasReleased) {
 				digMode = mb->lmb;
 				
-				if(animalManager->tryToHitAnimal(SCR_W / 2, SCR_H / 2, calcDistToSelBlock())) {
+				if(animalManager->tryToHitAnimal(SCR_W / 2, SCR_H / 2, calcDistToSelBlock(SCR_W / 2, SCR_H / 2))) {
 					mouseWasReleased = false;
 					return;
 				}
@@ -321,19 +393,6 @@ void LandscapeScene::processMouseInput(int dX, int dY, int wheel, MouseButtons *
 #endif
 }
 
-void LandscapeScene::refreshBlocksNearCam() {
-	// refresh blocksNearCam-list if neccessary.
-	if (blocksNearCam.empty()
-			|| !(lastCamPos == cam.getPos())
-			|| !(lastCamNormal == cam.getNormal())
-			|| nearBlocksDirty) {
-		lastCamPos.setTo(cam.getPosPtr());
-		blocksNearCam.clear();
-		terrain->blocksNear(&cam, &blocksNearCam);
-		if (nearBlocksDirty) nearBlocksDirty = false;
-	}
-}
-
 inline bool LandscapeScene::isStandingEntity(int etype, bool isDoor, bool selDoor, CubeFace selectedFace) {
 	return etype == Entity::GLASS || etype == Entity::FLOWER
 		   || (etype == Entity::TORCH && selectedFace == CF_TOP)
@@ -373,16 +432,20 @@ void LandscapeScene::doDigOrPut() {
 			break;
 		}
 
-		// put new block adjacent to selected face on right click
+		// put new block adjacent to selected face on right click,
+		// each put or dig is one action for undo, doors and their entities included
 		if (!digMode &&  terrain->isValidIndex(actualX, actualY, actualZ)) {
+			terrain->beginEdit();
 			putNewBlock(selDoor, selectedBlock, actualX, actualY, actualZ, selectedFace);
+			terrain->commitEdit();
 			// on left/middle mouse button click remove entire selected block
 		} else if (digMode && terrain->isValidIndex(selectedBlock->x, selectedBlock->y, selectedBlock->z)) {
+			terrain->beginEdit();
 			digExistingBlock(selectedBlock, selectedFace);
+			terrain->commitEdit();
 		} else return;
 
 		lastBlockPlacementTicks = getTicks();
-		nearBlocksDirty = true;
 	}
 }
 
@@ -400,7 +463,7 @@ void LandscapeScene::processTouch(int tX, int tY, ticks_t delta) {
 
 	if(!touchWasReleased) return;
 
-	if(animalManager->tryToHitAnimal(tX2, tY2, calcDistToSelBlock())) {
+	if(animalManager->tryToHitAnimal(tX2, tY2, calcDistToSelBlock(tX2, tY2))) {
 		touchWasReleased = false;
 		return;
 	}
@@ -429,11 +492,12 @@ void LandscapeScene::draw(ticks_t delta) {
 
 	mvmt->update(delta, crouching);
 	tntManager->update();
+	fluidManager->update();
 	animalManager->update(delta);
+	autosave();
 
 	// update selected block each frame on desktop
 	if (!MOBILE_MODE || activeInputMethod == IM_PC) {
-		refreshBlocksNearCam();
 		int x = (int)(SCR_W / 2.0f), y = (int)(SCR_H / 2.0f);
 #if IPHONE
 		int tmp = x;
@@ -445,11 +509,9 @@ void LandscapeScene::draw(ticks_t delta) {
 #elif ANDROID
 		y = SCR_H - y;
 #endif
-		landscapeRenderer->updateSelectedBlock(&blocksNearCam, x, y);
+		landscapeRenderer->updateSelectedBlock(x, y);
 	} else { // update selected block only on dig/put on mobile
 		if (sx != -1 && sy != -1) {
-			refreshBlocksNearCam();
-
 #if IPHONE
 			// TODO: Find out why tX and tY are correct for touch
 			// but messed up for picking...
@@ -462,7 +524,7 @@ void LandscapeScene::draw(ticks_t delta) {
 			sy2 = SCR_H - sy;
 #endif
 
-			landscapeRenderer->updateSelectedBlock(&blocksNearCam, sx2, sy2);
+			landscapeRenderer->updateSelectedBlock(sx2, sy2);
 			highlightSelBlock = true;
 		}
 	}
@@ -726,7 +788,8 @@ void LandscapeScene::digExistingBlock( BlockPos * selectedBlock, CubeFace select
 
 			digEntireBlock = true;
 
-		} else if (val + 1 == Terrain::INVIS_SOLID || val == Terrain::FENCE_TEX_INDEX) {
+		} else if (blockType((DATA_TYPE)(val + 1)).mesh != BlockType::MESH_CUBE) {
+			// entity placeholders and fences break in one go
 			val = 6;
 			digEntireBlock = true;
 		}
@@ -10,6 +10,7 @@
 #include "../Framework/State.hpp"
 #include "../Framework/Camera.hpp"
 
+#include "../Managers/FluidManager.hpp"
 #include "../Managers/TNTManager.hpp"
 
 namespace as {
@@ -31,6 +32,8 @@ class BlockPos;
 class Texture;
 class StateManager;
 class NetManager;
+class WorldFile;
+class WorldSnapshot;
 class InputMethod;
 class Player;
 class RailManager;
@@ -69,16 +72,17 @@ private:
 	void putNewBlock( bool &selDoor, BlockPos * selectedBlock, int actualX, int actualY, int actualZ, CubeFace selectedFace );
 	void digExistingBlock( BlockPos * selectedBlock, CubeFace selectedFace );
 
-	void refreshBlocksNearCam();
 
 	void commonInit(int seed, const char *filename, Terrain::TerrainSource tsource, bool mp, bool server);
+	bool tryLoadPos(const WorldFile &file);
 	bool tryLoadPosFromFile(const char *filename);
-	void savePosToFile(const char *filename);
+	void addPosToSnapshot(WorldSnapshot *snapshot);
 
 	void saveWorld();
+	void autosave();
 	bool isStandingEntity(int etype, bool isDoor, bool selDoor, CubeFace selectedFace);
 	
-	float calcDistToSelBlock();
+	float calcDistToSelBlock(int x, int y);
 
 	StateManager *g;
 
@@ -90,10 +94,7 @@ private:
 	HudRenderer *hudRenderer;
 
 	ticks_t lastBlockPlacementTicks, lastTexSwitch;
-
-	Vec3 lastCamPos, lastCamNormal;
-	std::list<BlockPos> blocksNearCam;
-	bool nearBlocksDirty;
+	ticks_t lastSaveTicks;
 
 	LightSource *lsource;
 
@@ -104,11 +105,14 @@ private:
 	int posArray[3];
 
 	TNTManager *tntManager;
+	FluidManager *fluidManager;
 	AnimalManager *animalManager;
 	NetManager *netManager;
 	RailManager *railManager;
 
 	bool crouching;
+	// undo/redo step once per key press
+	bool undoKeyDown;
 	
 	Camera cam;
 	
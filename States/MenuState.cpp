@@ -796,6 +796,7 @@ void MenuState::processLoadWorldScreen(std::string &action) {
 		if(determineNumWorlds() == 0) return;
 
 		constructWorldFilename();
+		Terrain::deleteWorldFiles(worldFilename);
 		deleteFile(worldFilename);
 
 		const std::array suffices {
@@ -5,11 +5,14 @@
 #include <cstdlib>
 #include <cstdio>
 #include <cmath>
-#include <ctime>
+#include <cfloat>
+#include <cstring>
 #include <fstream>
 
 #include "Framework/Utilities.hpp"
+#include "Framework/ByteBuffer.hpp"
 #include "Framework/Math/Noise.hpp"
+#include "Framework/Math/Random.hpp"
 
 #include "Terrain.hpp"
 #include "Constants.h"
@@ -18,13 +21,13 @@
 // Constants
 //===========================================================================
 namespace as {
-#define NEAR_DIST nearDist
 
 const char *DEF_FILENAME = "terrain.dump";
 
-inline float LDIST(BlockPos pos, float x, float y, float z) {
-	return (Vec3((float)pos.x + 0.5f, (float)pos.y, (float)pos.z + 0.5f) - Vec3(x, y, z)).length();
-}
+// neighbours a light spreads to
+static const int LIGHT_DIRS[6][3] = {
+	{-1, 0, 0}, {1, 0, 0}, {0, -1, 0}, {0, 1, 0}, {0, 0, -1}, {0, 0, 1}
+};
 
 //===========================================================================
 // Globals
@@ -35,22 +38,42 @@ int nblocks_near;
 static DATA_TYPE FAV_TEX_IDS[] = {
 	0, 1, 4, 5, 6, 9, 11, 12, 15, 16, 17, 18, 32, 33, 34, 4
 };
+const int NUM_FAV_TEX_IDS = sizeof(FAV_TEX_IDS) / sizeof(DATA_TYPE);
+
+// scale of the cave and ore density noise in blocks
+const float CAVE_ZOOM = 24;
+const float ORE_ZOOM = 4;
+// radius of the tunnels in density units, and the density above which stone turns into gold
+const float CAVE_WIDTH = 0.12f;
+const float ORE_DENSITY = 0.85f;
+
+static const std::vector<BlockPos> NO_CHANGES;
 
 //===========================================================================
 // Methods
 //===========================================================================
 
 inline bool Terrain::isEmptyOrGlass(int x, int y, int z) const {
-	DATA_TYPE val = get(x,y,z);
-	return (!val || isInvisible(val) || (val == Terrain::FENCE_TEX_INDEX + 1));
+	return !castsShadow(get(x, y, z));
 }
 
-Terrain::Terrain(TerrainSource source, int _seed)
-:	entityUpdate(false),
+Terrain::Terrain(TerrainSource _source, int _seed)
+:	numEntities(0),
+	entitiesModified(false),
+	entityUpdate(false),
 	seed(_seed),
+	editDepth(0),
+	sectionUpdate(false),
+	reportedChanges(&NO_CHANGES),
+	replaying(false),
 	lastEntity(NULL),
 	deleteEntity(false),
-	numWaterBlocks(0)
+	source(_source),
+	loadRadius(0),
+	spawnX(WORLD_CENTER),
+	spawnZ(WORLD_CENTER),
+	pendingSave(NULL),
+	saveDone(true)
 {
 	if (visualDetail == DETAIL_VERY_LOW)
 		nearDist = 4;
@@ -59,27 +82,23 @@ Terrain::Terrain(TerrainSource source, int _seed)
 	else
 		nearDist = 8;
 
+	invalidateColumnCache();
+
 	switch (source) {
 	case TS_EMPTY:
-		// do nothing.
+		// network clients receive the area of the old fixed-size map
+		spawnX = spawnZ = LEGACY_TERRAIN_SIZE / 2;
 		break;
 	case TS_FILE:
 		loadTerrainFromFile(NULL);
 		break;
 	case TS_SPHERE:
-		generateSpherishTerrain();
-		break;
 	case TS_PYRAMID:
-		generatePyramidTerrain();
-		break;
 	case TS_RANDOM:
-		generateRandomTerrain(true);
-		break;
 	case TS_FLAT:
-		generateFlatTerrain();
-		break;
 	case TS_PERLIN:
-		generatePerlinTerrain();
+		// columns are generated on demand by loadColumnsAround()
+		initGenerator();
 		break;
 	default:
 		error("Unknown terrain source!");
@@ -88,28 +107,374 @@ Terrain::Terrain(TerrainSource source, int _seed)
 }
 
 Terrain::~Terrain() {
+	finishSave();
+	clearTerrain();
 	SAFE_DELETE(lastEntity);
 }
 
+//===========================================================================
+// World files
+//===========================================================================
+/*
+ Worlds are saved as a WorldFile plus the region files holding their columns.
+ The original fixed-size voxel dumps are still read: they are imported into the
+ columns they covered, and the entities, animals and player position they kept
+ in files next to them go into the world file with the next save.
+*/
+static const char *LEGACY_SUFFIXES[] = { ".entities", ".edescr", ".animals", ".adescr", ".spawnpos" };
+
+void Terrain::loadTerrain(const WorldFile &file, const char *filename) {
+	finishSave();
+	clearTerrain();
+	savedColumns.clear();
+	obsoleteFiles.clear();
+	worldFilename = filename;
+	regions.open(worldFilename, file.getSection(WorldFile::SEC_REGIONS));
+
+	const WorldFile::Info &info = file.getInfo();
+	if (info.height != MAX_Y || info.chunkShift != CHUNK_SHIFT)
+		error("World was saved with a different world layout!");
+
+	source = (TerrainSource)info.source;
+	seed = info.seed;
+	spawnX = info.spawnX;
+	spawnZ = info.spawnZ;
+	initGenerator();
+}
+
+// voxel dumps, see above
 void Terrain::loadTerrainFromFile(const char *filename) {
-#if IPHONE && 0
-	// Check for old uncompressed world on IOS
-	if(IOS_FileExists(filename, false)) {
-		DATA_TYPE smallBuf[256*256*16];
-		binaryRead(filename, smallBuf, sizeof(DATA_TYPE) * 256*256*16);
-		clearTerrain();
-		for(int x=0; x<256; x++)
-			for(int y=0; y<16; y++)
-				for(int z=0; z<256; z++)
-					quickSet(x, y, z, smallBuf[x*(16*256)+y*256+z]);
-		return;
+	if (!filename)
+		filename = DEF_FILENAME;
+
+	finishSave();
+	clearTerrain();
+	savedColumns.clear();
+	obsoleteFiles.clear();
+	worldFilename = filename;
+	regions.open(worldFilename, std::vector<uchar>());
+
+	char sideFilename[BUF_LEN];
+	for (size_t i = 0; i < sizeof(LEGACY_SUFFIXES) / sizeof(LEGACY_SUFFIXES[0]); i++) {
+		std::sprintf(sideFilename, "%s%s", filename, LEGACY_SUFFIXES[i]);
+		if (fileExists(sideFilename))
+			obsoleteFiles.push_back(sideFilename);
+	}
+
+	importLegacyTerrain(filename);
+}
+
+void Terrain::importLegacyTerrain(const char *filename) {
+	DATA_TYPE *buf = new DATA_TYPE[LEGACY_MAX_BLOCKS];
+	binaryRead(filename, (char *)buf, sizeof(DATA_TYPE) * LEGACY_MAX_BLOCKS);
+	importBlocks(buf);
+	SAFE_DELETE_ARRAY(buf);
+
+	// everything outside of the old map is new perlin terrain
+	source = TS_PERLIN;
+	spawnX = spawnZ = LEGACY_TERRAIN_SIZE / 2;
+	initGenerator();
+}
+
+void Terrain::setWorldFilename(const char *filename) {
+	std::string prevFilename = worldFilename;
+	if (filename)
+		worldFilename = filename;
+	else if (worldFilename.empty())
+		worldFilename = DEF_FILENAME;
+
+	// saved under another name: all columns go into the regions of the new file
+	if (worldFilename != prevFilename) {
+		WorldFile::ColumnBlobMap stored;
+		regions.readAll(&stored);
+		savedColumns.insert(stored.begin(), stored.end());
+		regions.open(worldFilename, std::vector<uchar>());
+	}
+}
+
+// synchronous, e.g. to create the file of a new world right away
+void Terrain::saveTerrainToFile(const char *filename) {
+	WorldSnapshot *snapshot = new WorldSnapshot();
+	addTerrainToSnapshot(snapshot, filename);
+	addEntitiesToSnapshot(snapshot);
+	writeInBackground(snapshot);
+	finishSave();
+}
+
+// only columns changed since the last save go into the snapshot: resident ones as
+// copy on write copies of their blocks, which the writer encodes, evicted ones as they were encoded
+void Terrain::addTerrainToSnapshot(WorldSnapshot *snapshot, const char *filename) {
+	// a column may only be pending in one snapshot
+	finishSave();
+
+	setWorldFilename(filename);
+	snapshot->setFilename(worldFilename);
+	snapshot->setRegions(&regions);
+
+	WorldFile &file = snapshot->getFile();
+	WorldFile::Info info;
+	info.height = MAX_Y;
+	info.chunkShift = CHUNK_SHIFT;
+	info.source = source;
+	info.seed = seed;
+	info.spawnX = spawnX;
+	info.spawnZ = spawnZ;
+	file.setInfo(info);
+
+	ColumnMap::iterator it;
+	for (it = columns.begin(); it != columns.end(); ++it) {
+		ChunkColumn *col = it->second;
+		if (!col->modified) continue;
+
+		snapshot->addColumn(new ColumnBlocks(*col));
+		savedColumns[col->getKey()] = WorldFile::ColumnBlob();
+		col->modified = false;
+	}
+
+	WorldFile::ColumnBlobMap::const_iterator sit;
+	for (sit = savedColumns.begin(); sit != savedColumns.end(); ++sit) {
+		if (sit->second)
+			snapshot->addColumn(sit->first, sit->second);
+	}
+
+	for (size_t i = 0; i < obsoleteFiles.size(); i++) {
+		snapshot->addObsoleteFile(obsoleteFiles[i]);
+	}
+	obsoleteFiles.clear();
+}
+
+static void writeSnapshot(WorldSnapshot *snapshot, std::atomic<bool> *done) {
+	snapshot->write();
+	*done = true;
+}
+
+// takes ownership of snapshot
+void Terrain::writeInBackground(WorldSnapshot *snapshot) {
+	finishSave();
+	pendingSave = snapshot;
+	saveDone = false;
+	saveThread = std::thread(writeSnapshot, snapshot, &saveDone);
+}
+
+void Terrain::finishSave() {
+	if (!saveThread.joinable()) return;
+	saveThread.join();
+
+	// written columns are read from their regions from now on, unless they were stored again meanwhile
+	const WorldFile::ColumnBlobMap &written = pendingSave->getColumnBlobs();
+	WorldFile::ColumnBlobMap::iterator it;
+	for (it = savedColumns.begin(); it != savedColumns.end();) {
+		WorldFile::ColumnBlobMap::const_iterator wit = written.find(it->first);
+		if (!it->second || (wit != written.end() && wit->second == it->second))
+			savedColumns.erase(it++);
+		else ++it;
+	}
+
+	SAFE_DELETE(pendingSave);
+}
+
+bool Terrain::hasUnsavedChanges() const {
+	if (entitiesModified || !savedColumns.empty())
+		return true;
+
+	ColumnMap::const_iterator it;
+	for (it = columns.begin(); it != columns.end(); ++it) {
+		if (it->second->modified)
+			return true;
+	}
+	return false;
+}
+
+void Terrain::deleteWorldFiles(const char *filename) {
+	WorldFile file;
+	if (file.load(filename))
+		WorldRegions::deleteFiles(filename, file.getSection(WorldFile::SEC_REGIONS));
+}
+
+// the flat x-major layout of the old fixed-size world files (x*(HEIGHT*SIZE)+y*SIZE+z)
+void Terrain::exportBlocks(DATA_TYPE *dest) const {
+	for (int x = 0; x < LEGACY_TERRAIN_SIZE; x++) {
+		for (int y = 0; y < LEGACY_TERRAIN_HEIGHT; y++) {
+			for (int z = 0; z < LEGACY_TERRAIN_SIZE; z++) {
+				*dest++ = get(x, y, z);
+			}
+		}
+	}
+}
+
+void Terrain::importBlocks(const DATA_TYPE *src) {
+	DATA_TYPE vals[ChunkColumn::NUM_BLOCKS];
+	const int E = CHUNK_SIZE;
+	const int H = LEGACY_TERRAIN_HEIGHT < MAX_Y ? LEGACY_TERRAIN_HEIGHT : MAX_Y;
+	const int NUM_LEGACY_COLUMNS = LEGACY_TERRAIN_SIZE / E;
+
+	std::vector<ChunkColumn *> imported;
+
+	memset(vals, 0, sizeof(vals));
+
+	for (int cx = 0; cx < NUM_LEGACY_COLUMNS; cx++) {
+		for (int cz = 0; cz < NUM_LEGACY_COLUMNS; cz++) {
+			for (int lx = 0; lx < E; lx++) {
+				for (int y = 0; y < H; y++) {
+					memcpy(&vals[lx*(MAX_Y*E) + y*E],
+						   &src[(cx*E + lx)*(LEGACY_TERRAIN_HEIGHT*LEGACY_TERRAIN_SIZE) + y*LEGACY_TERRAIN_SIZE + cz*E], E);
+				}
+			}
+
+			ChunkColumn *col = findColumn(cx, cz);
+			if (!col) {
+				col = new ChunkColumn(cx, cz);
+				columns[col->getKey()] = col;
+				invalidateColumnCache();
+			}
+			col->importBlocks(vals);
+			computeHeights(col);
+			computeColumnLight(col);
+			imported.push_back(col);
+		}
+	}
+
+	resolveOpenDoors(imported);
+	lightColumns(imported);
+}
+
+void Terrain::computeHeights(ChunkColumn *col) {
+	for (int lx = 0; lx < CHUNK_SIZE; lx++) {
+		for (int lz = 0; lz < CHUNK_SIZE; lz++) {
+			short &sky = col->skyHeightAt(lx, lz);
+			short &top = col->topHeightAt(lx, lz);
+
+			for (top = MAX_Y; top > 0 && col->get(lx, top - 1, lz) == 0; top--) ;
+			for (sky = top; sky > 0 && !castsShadow(col->get(lx, sky - 1, lz)); sky--) ;
+		}
+	}
+}
+
+size_t Terrain::memoryUsage() const {
+	size_t bytes = sizeof(Terrain);
+	ColumnMap::const_iterator it;
+	for (it = columns.begin(); it != columns.end(); ++it) {
+		bytes += it->second->memoryUsage();
+	}
+	return bytes;
+}
+
+//===========================================================================
+// Column streaming
+//===========================================================================
+// all at once, e.g. before there is anything to show
+void Terrain::loadColumnsAround(int cx, int cz, int radius) {
+	requestColumnsAround(cx, cz, radius);
+	streamColumns((int)pendingColumns.size());
+}
+
+void Terrain::requestColumnsAround(int cx, int cz, int radius) {
+	int keepDist = radius + EVICT_MARGIN;
+
+	loadRadius = radius;
+
+	// release a written snapshot so its columns stop sharing storage with the live ones
+	if (saveDone)
+		finishSave();
+
+	ColumnMap::iterator it;
+	for (it = columns.begin(); it != columns.end();) {
+		ChunkColumn *col = it->second;
+		if (ABS(col->getX() - cx) > keepDist || ABS(col->getZ() - cz) > keepDist) {
+			storeColumn(col);
+			SAFE_DELETE(col);
+			columns.erase(it++);
+		} else ++it;
+	}
+	invalidateColumnCache();
+
+	// ring by ring, so the columns around the center are the first ones streamed in
+	pendingColumns.clear();
+	for (int k = 0; k <= radius; k++) {
+		for (int x = cx - k; x <= cx + k; x++) {
+			// whole rows on the ring's left and right edge, only its two ends in between
+			int step = (x == cx - k || x == cx + k) ? 1 : 2 * k;
+			for (int z = cz - k; z <= cz + k; z += step) {
+				if (x < 0 || z < 0 || findColumn(x, z)) continue;
+				pendingColumns.push_back(ChunkColumn::makeKey(x, z));
+			}
+		}
+	}
+}
+
+int Terrain::streamColumns(int maxColumns) {
+	std::vector<ChunkColumn *> newColumns, loadedColumns;
+	while (!pendingColumns.empty() && (int)(newColumns.size() + loadedColumns.size()) < maxColumns) {
+		ChunkKey key = pendingColumns.front();
+		pendingColumns.pop_front();
+		int x = (int)(key >> 32), z = (int)key;
+		if (findColumn(x, z)) continue;
+
+		ChunkColumn *col = new ChunkColumn(x, z);
+		columns[col->getKey()] = col;
+		invalidateColumnCache();
+		if (loadColumn(col))
+			loadedColumns.push_back(col);
+		else
+			newColumns.push_back(col);
+	}
+
+	// columns are generated independently of each other, so in parallel
+	generatorPool.parallelFor((int)newColumns.size(), [&](int i) {
+		generateColumn(newColumns[i]);
+	});
+
+	loadedColumns.insert(loadedColumns.end(), newColumns.begin(), newColumns.end());
+	resolveOpenDoors(loadedColumns);
+	lightColumns(loadedColumns);
+	if (editDepth == 0)
+		notifyDirtySections();
+	return (int)loadedColumns.size();
+}
+
+bool Terrain::hasColumnsAround(int cx, int cz) const {
+	for (int x = cx - 1; x <= cx + 1; x++) {
+		for (int z = cz - 1; z <= cz + 1; z++) {
+			if (x >= 0 && z >= 0 && !findColumn(x, z))
+				return false;
+		}
+	}
+	return true;
+}
+
+// false if the column was never saved
+bool Terrain::loadColumn(ChunkColumn *col) {
+	WorldFile::ColumnBlobMap::iterator saved = savedColumns.find(col->getKey());
+	// not in its region before the running save is done
+	if (saved != savedColumns.end() && !saved->second) {
+		finishSave();
+		saved = savedColumns.find(col->getKey());
 	}
-#endif
-	binaryRead((!filename ? DEF_FILENAME : filename), (char *)data, sizeof(DATA_TYPE) * MAX_BLOCKS);
+
+	std::vector<uchar> stored;
+	const std::vector<uchar> *blob = NULL;
+	if (saved != savedColumns.end())
+		blob = saved->second.get();
+	else if (regions.read(col->getKey(), &stored))
+		blob = &stored;
+
+	if (!blob || !col->decode(blob->data(), blob->size()))
+		return false;
+
+	computeHeights(col);
+	computeColumnLight(col);
+	return true;
 }
 
-void Terrain::saveTerrainToFile(const char *filename) const {
-	binaryWrite((!filename ? DEF_FILENAME : filename), (char *)data, sizeof(DATA_TYPE) * MAX_BLOCKS);
+// keeps the encoded column until the next save writes it
+void Terrain::storeColumn(ChunkColumn *col) {
+	if (!col->modified)
+		return;
+
+	std::vector<uchar> *blob = new std::vector<uchar>();
+	col->encode(blob);
+	savedColumns[col->getKey()] = WorldFile::ColumnBlob(blob);
+	col->modified = false;
 }
 
 void Terrain::loadEntitiesFromFile(const char *filename) {
@@ -130,6 +495,8 @@ void Terrain::loadEntitiesFromFile(const char *filename) {
 	binaryRead(entFilename, entArray, sizeof(Entity) * l);
 
 	entities.clear();
+	numEntities = 0;
+	journal.clear();
 
 	for (int i = 0; i < l; i++) {
 		//entities.push_back(entArray[i]);
@@ -139,74 +506,118 @@ void Terrain::loadEntitiesFromFile(const char *filename) {
 	SAFE_DELETE_ARRAY(entArray);
 }
 
-void Terrain::saveEntitiesToFile(const char *filename) const {
-	char entFilename[BUF_LEN], entDescrFilename[BUF_LEN];
-	size_t l = entities.size();
+void Terrain::loadEntities(const WorldFile &file) {
+	const std::vector<uchar> &data = file.getSection(WorldFile::SEC_ENTITIES);
+	ByteReader r(data.data(), data.size());
 
-	//if(!l) return;
-
-	strcpy(entFilename, filename);
-	strcpy(entDescrFilename, filename);
-
-	strcat(entFilename, ".entities");
-	strcat(entDescrFilename, ".edescr");
-
-	binaryWrite(entDescrFilename, &l, sizeof(int));
-
-	Entity *entArray = new Entity[l];
+	entities.clear();
+	numEntities = 0;
+	journal.clear();
 
-	std::list<Entity>::const_iterator it;
-	int i = 0;
-	for (it = entities.begin(); it != entities.end(); ++it) {
-		entArray[i++] = (*it);
+	int l = r.getInt();
+	for (int i = 0; i < l; i++) {
+		int x = r.getInt();
+		int y = r.getInt();
+		int z = r.getInt();
+		Entity::EntityType type = (Entity::EntityType)r.getByte();
+		CubeFace cface = (CubeFace)r.getByte();
+		if (!r.ok()) break;
+
+		addEntity(Entity(x, y, z, type, cface));
 	}
-
-	binaryWrite(entFilename, entArray, sizeof(Entity) * l);
-
-	SAFE_DELETE_ARRAY(entArray);
+	entitiesModified = false;
 }
 
-void Terrain::blocksNear(Camera *cam, std::list<BlockPos> *blocksNear) const {
-	static float alpha;
-	static Vec3 *camPos, camToPoint;
-	static int x, y, z;
-
-	camPos = cam->getPosPtr();
-
-	x = (int)camPos->x;
-	y = (int)camPos->y;
-	z = (int)camPos->z;
+void Terrain::addEntitiesToSnapshot(WorldSnapshot *snapshot) {
+	std::vector<uchar> data;
+	ByteWriter w(&data);
+
+	// straight from the index, this runs on the main thread while saving
+	data.reserve(4 + numEntities * 14);
+	w.putInt((int)numEntities);
+
+	EntityIndex::const_iterator chunk;
+	EntityCells::const_iterator cell;
+	for (chunk = entities.begin(); chunk != entities.end(); ++chunk) {
+		for (cell = chunk->second.begin(); cell != chunk->second.end(); ++cell) {
+			for (size_t i = 0; i < cell->second.size(); i++) {
+				const Entity &e = cell->second[i];
+				w.putInt(e.pos.x);
+				w.putInt(e.pos.y);
+				w.putInt(e.pos.z);
+				w.putByte((uchar)e.type);
+				w.putByte((uchar)e.cface);
+			}
+		}
+	}
 
-	for (int a = x - NEAR_DIST; a <= x + NEAR_DIST; a++) {
-		for (int b = y - NEAR_DIST; b <= y + NEAR_DIST; b++) {
-			for (int c = z - NEAR_DIST; c <= z + NEAR_DIST; c++) {
-				if (a < 0 || b < 0 || c < 0 || a >= MAX_X || b >= MAX_Y || c >= MAX_Z)
-					continue;
+	snapshot->getFile().setSection(WorldFile::SEC_ENTITIES, &data);
+	entitiesModified = false;
+}
 
-				// also allow selection of invisible blocks (for entities)
-				if (get(a, b, c) != 0) {
-					// heuristic to drop blocks outside of FOV
-					camToPoint.setTo(a + 0.5f, b + 0.5f, c + 0.5f);
-					camToPoint.subInPlace(camPos);
-					alpha = camToPoint.angleBetweenNor(cam->getNormal());
-					if (alpha >= FOV_RAD + PI / 10.0f)
-						continue;
+// Amanatides & Woo: visits the cells along the ray in order, one step per cell boundary
+bool Terrain::raycast(const Vec3 &origin, const Vec3 &dir, float maxDist, BlockHit *hit) const {
+	int x = (int)std::floor(origin.x), y = (int)std::floor(origin.y), z = (int)std::floor(origin.z);
+	int stepX = (dir.x > 0) ? 1 : -1, stepY = (dir.y > 0) ? 1 : -1, stepZ = (dir.z > 0) ? 1 : -1;
+
+	// ray length per cell along each axis, and up to the first boundary
+	float deltaX = (dir.x != 0) ? std::fabs(1.0f / dir.x) : FLT_MAX;
+	float deltaY = (dir.y != 0) ? std::fabs(1.0f / dir.y) : FLT_MAX;
+	float deltaZ = (dir.z != 0) ? std::fabs(1.0f / dir.z) : FLT_MAX;
+	float tMaxX = (dir.x != 0) ? ((stepX > 0) ? (x + 1 - origin.x) : (origin.x - x)) * deltaX : FLT_MAX;
+	float tMaxY = (dir.y != 0) ? ((stepY > 0) ? (y + 1 - origin.y) : (origin.y - y)) * deltaY : FLT_MAX;
+	float tMaxZ = (dir.z != 0) ? ((stepZ > 0) ? (z + 1 - origin.z) : (origin.z - z)) * deltaZ : FLT_MAX;
+
+	// inside a block: the face towards the viewer along the main axis
+	CubeFace face;
+	if (std::fabs(dir.x) >= std::fabs(dir.y) && std::fabs(dir.x) >= std::fabs(dir.z))
+		face = (stepX > 0) ? CF_LEFT : CF_RIGHT;
+	else if (std::fabs(dir.y) >= std::fabs(dir.z))
+		face = (stepY > 0) ? CF_BOTTOM : CF_TOP;
+	else
+		face = (stepZ > 0) ? CF_BACK : CF_FRONT;
+	float t = 0;
+
+	for (;;) {
+		// also allow selection of invisible blocks (for entities)
+		if (y >= 0 && y < MAX_Y && get(x, y, z) != 0) {
+			hit->pos = BlockPos(x, y, z);
+			hit->face = face;
+			hit->dist = t;
+			return true;
+		}
 
-					blocksNear->push_back(BlockPos(a, b, c));
-				}
-			}
+		if (tMaxX < tMaxY && tMaxX < tMaxZ) {
+			t = tMaxX;
+			tMaxX += deltaX;
+			x += stepX;
+			face = (stepX > 0) ? CF_LEFT : CF_RIGHT;
+		} else if (tMaxY < tMaxZ) {
+			t = tMaxY;
+			tMaxY += deltaY;
+			y += stepY;
+			face = (stepY > 0) ? CF_BOTTOM : CF_TOP;
+		} else {
+			t = tMaxZ;
+			tMaxZ += deltaZ;
+			z += stepZ;
+			face = (stepZ > 0) ? CF_BACK : CF_FRONT;
 		}
+
+		// nothing left above or below the world
+		if (t > maxDist || (y < 0 && stepY < 0) || (y >= MAX_Y && stepY > 0))
+			return false;
 	}
 }
 
 VisibleFaces Terrain::determineVisibleFaces( int x, int y, int z ) const {
 	VisibleFaces tmpVisFaces;
 
-	tmpVisFaces.front = (z == MAX_Z - 1 || isEmptyOrGlass(x, y, z + 1));
-	tmpVisFaces.back = (z == 0 || isEmptyOrGlass(x, y, z - 1));
+	tmpVisFaces.front = isEmptyOrGlass(x, y, z + 1);
+	tmpVisFaces.back = isEmptyOrGlass(x, y, z - 1);
 
-	tmpVisFaces.left = (x == 0 || isEmptyOrGlass(x - 1, y, z));
-	tmpVisFaces.right = (x == MAX_X - 1 || isEmptyOrGlass(x + 1, y, z));
+	tmpVisFaces.left = isEmptyOrGlass(x - 1, y, z);
+	tmpVisFaces.right = isEmptyOrGlass(x + 1, y, z);
 
 	tmpVisFaces.bottom = (y == 0 || isEmptyOrGlass(x, y - 1, z));
 	tmpVisFaces.top = (y == MAX_Y - 1 || isEmptyOrGlass(x, y + 1, z));
@@ -215,43 +626,90 @@ VisibleFaces Terrain::determineVisibleFaces( int x, int y, int z ) const {
 }
 
 void Terrain::clearTerrain() {
-	memset(data, 0, sizeof(DATA_TYPE) * MAX_BLOCKS);
+	ColumnMap::iterator it;
+	for (it = columns.begin(); it != columns.end(); ++it) {
+		SAFE_DELETE(it->second);
+	}
+	columns.clear();
+	invalidateColumnCache();
+	journal.clear();
+}
+
+void Terrain::initGenerator() {
+	// not rand(), its sequence differs between C libraries
+	Random rng((unsigned int)seed);
+	perlinRval = rng.next();
+	roughnessRval = rng.next();
+	caveRvals[0] = rng.next();
+	caveRvals[1] = rng.next();
+	oreRval = rng.next();
+}
+
+// a function of the seed and the column's coordinates only, it may run on any thread
+void Terrain::generateColumn(ChunkColumn *col) const {
+	Random rng(Random::cellSeed(seed, col->getX(), col->getZ()));
+
+	switch (source) {
+	case TS_SPHERE:
+		generateSpherishTerrain(col);
+		break;
+	case TS_PYRAMID:
+		generatePyramidTerrain(col);
+		break;
+	case TS_RANDOM:
+		generateRandomTerrain(col, &rng, true);
+		break;
+	case TS_FLAT:
+		generateFlatTerrain(col);
+		break;
+	case TS_PERLIN:
+		generatePerlinTerrain(col, &rng);
+		break;
+	default:
+		// empty column
+		return;
+	}
+
+	col->compact();
+	computeHeights(col);
+	computeColumnLight(col);
+
+	// can be generated again, so it is only saved once it is edited
+	col->modified = false;
 }
 
-void Terrain::generateSpherishTerrain() {
-	int x, y, z;
-	Vec3 center(MAX_X / 2, MAX_Y / 2, MAX_Z / 2);
+void Terrain::generateSpherishTerrain(ChunkColumn *col) const {
+	int minX = col->getX() * CHUNK_SIZE, minZ = col->getZ() * CHUNK_SIZE;
+	Vec3 center((float)spawnX, MAX_Y / 2, (float)spawnZ);
 
-	for (x = 0; x < MAX_X; x++) {
-		for (y = 0; y < MAX_Y; y++) {
-			for (z = 0; z < MAX_Z; z++) {
-				Vec3 tmp((float)x, (float)y, (float)z);
+	for (int lx = 0; lx < CHUNK_SIZE; lx++) {
+		for (int y = 0; y < MAX_Y; y++) {
+			for (int lz = 0; lz < CHUNK_SIZE; lz++) {
+				Vec3 tmp((float)(minX + lx), (float)y, (float)(minZ + lz));
 				Vec3 diff = tmp - center;
 				float dst = diff.length();
-				quickSet(x, y, z, (y == 0) ? 1 : (dst > MAX_Y / 2 - 2 && dst < MAX_Y / 2) ? FAV_TEX_IDS[y/4] + 1 : 0);
+				col->set(lx, y, lz, (y == 0) ? 1 : (dst > MAX_Y / 2 - 2 && dst < MAX_Y / 2) ? FAV_TEX_IDS[y * NUM_FAV_TEX_IDS / MAX_Y] + 1 : 0);
 			}
 		}
 	}
 }
 
-void Terrain::generateRandomTerrain(bool smallSteps) {
-	int x, y, z, height, oldHeight = DEFAULT_HEIGHT;
-
-	std::srand((int)std::time(NULL));
+void Terrain::generateRandomTerrain(ChunkColumn *col, Random *rng, bool smallSteps) const {
+	int y, height, oldHeight = DEFAULT_HEIGHT;
 
-	for (x = 0; x < MAX_X; x++) {
-		for (z = 0; z < MAX_Z; z++) {
+	for (int lx = 0; lx < CHUNK_SIZE; lx++) {
+		for (int lz = 0; lz < CHUNK_SIZE; lz++) {
 			if (smallSteps) {
-				height = oldHeight + (rand() % (MAX_SMALL_STEP_DIFF) - 1);
+				height = oldHeight + (rng->nextInt(MAX_SMALL_STEP_DIFF) - 1);
 				// clamp between 0 and TERRAIN_D-1
 				height = (height >= MAX_Y) ? MAX_Y - 1 : height;
 				height = (height < 0) ? 0 : height;
 			} else {
-				height = rand() % (MAX_RAND_HEIGHT);
+				height = rng->nextInt(MAX_RAND_HEIGHT);
 			}
 
 			for (y = 0; y < MAX_Y; y++) {
-				quickSet(x, y, z, (y <= height) ? randomlyChooseTexId() : 0);
+				col->set(lx, y, lz, (y <= height) ? randomlyChooseTexId(rng) : 0);
 			}
 		}
 	}
@@ -271,42 +729,46 @@ enum BlockTexIndices {
 	TID_STONE_VAR = 33
 };
 
-DATA_TYPE Terrain::chooseTexForHeight(int blockHeight, int colHeight) {
+DATA_TYPE Terrain::chooseTexForHeight(int blockHeight, int colHeight, Random *rng, int *numWaterBlocks) {
 	float k = (float)blockHeight / (float)colHeight;
 	float l = (float)blockHeight / TMAX_Y;
 	float m = (float)colHeight / TMAX_Y;
 	DATA_TYPE r;
 	
-	float rval = 0.01f * (rand() % 5 - 2);
+	float rval = 0.01f * (rng->nextInt(5) - 2);
 
 	if (l >= 0.3f) {
-		if (k <= 0.3f + rval) r = (rand() % 5 == 0) ? TID_BRIGHT_STONE : TID_STONE_VAR;
+		if (k <= 0.3f + rval) r = (rng->nextInt(5) == 0) ? TID_BRIGHT_STONE : TID_STONE_VAR;
 		else if (k <= 0.45f + rval) r = TID_DARK_STONE;
-		else if (k <= (0.75f + (rand() % 8)*0.01f)) r = (rand() % 100 == 0) ? TID_GOLD_STONE : TID_BRIGHT_STONE;
+		else if (k <= (0.75f + rng->nextInt(8)*0.01f)) r = (rng->nextInt(100) == 0) ? TID_GOLD_STONE : TID_BRIGHT_STONE;
 		else if (k <= 0.90f + rval) r = TID_DIRT;
 		else r = (TMAX_Y - colHeight < 2) ?  TID_SNOW : (blockHeight == colHeight) ? TID_GRASS : TID_DIRT;
 	} else if (l <= 0.1f && colHeight <= 1) {
-		r = (numWaterBlocks < MAX_WATER_BLOCKS) ? TID_WATER : TID_SAND;
-		numWaterBlocks++;
+		r = (*numWaterBlocks < MAX_WATER_BLOCKS) ? TID_WATER : TID_SAND;
+		(*numWaterBlocks)++;
 	}
-	else if (l <= 0.2f + rval && m < 0.2f) r = (rand() % 5 == 0) ? TID_SAND_BRICKS : TID_SAND;
+	else if (l <= 0.2f + rval && m < 0.2f) r = (rng->nextInt(5) == 0) ? TID_SAND_BRICKS : TID_SAND;
 	else r = (rval == 0) ? TID_BRIGHT_STONE : TID_DARK_STONE;
 
 	return r + 1;
 }
 
-void Terrain::addTree(int baseX, int baseY, int baseZ) {
-	if (!isValidIndex(baseX - 1, baseY, baseZ - 1) || !isValidIndex(baseX + 1, baseY + 5 + 3, baseZ + 1))
-		return;
+// trees may reach into neighbouring columns, only the part within col is placed
+static inline void setInColumn(ChunkColumn *col, int lx, int y, int lz, DATA_TYPE val) {
+	if (lx >= 0 && lx < Terrain::CHUNK_SIZE && lz >= 0 && lz < Terrain::CHUNK_SIZE)
+		col->set(lx, y, lz, val);
+}
 
+// lx/lz: trunk position relative to col, may be outside of it
+void Terrain::addTree(ChunkColumn *col, int lx, int baseY, int lz, Random *rng) {
 	if (baseY + 3 + 4 + 1 >= TMAX_Y) return;
 	
-	if(rand() % 2 == 0) return;
+	if(rng->nextInt(2) == 0) return;
 
-	int treeBaseHeight = rand() % 4 + 4;
+	int treeBaseHeight = rng->nextInt(4) + 4;
 
 	for (int i = 1; i <= treeBaseHeight; i++) {
-		quickSet(baseX, baseY + i, baseZ, TREE_BASE_TEX);
+		setInColumn(col, lx, baseY + i, lz, TREE_BASE_TEX);
 	}
 
 	// tree top
@@ -315,259 +777,844 @@ void Terrain::addTree(int baseX, int baseY, int baseZ) {
 			if ((i == 0 && j == 0) || (i == 2 && j == 2) || (i == -2 && j == -2) || (i == -2 && j == 2) || (i == 2 && j == -2))
 				continue;
 			
-			quickSet(baseX + i, baseY + treeBaseHeight - 1, baseZ + j, TREE_TOP_TEX);
+			setInColumn(col, lx + i, baseY + treeBaseHeight - 1, lz + j, TREE_TOP_TEX);
 
-			if (i > 1 || i < -1 || j > 1 || j < -1 || rand() % 3 == 0)
+			if (i > 1 || i < -1 || j > 1 || j < -1 || rng->nextInt(3) == 0)
 				continue;
 
-			quickSet(baseX + i, baseY + treeBaseHeight - 2, baseZ + j, TREE_TOP_TEX);
-			quickSet(baseX + i, baseY + treeBaseHeight, baseZ + j, TREE_TOP_TEX);
+			setInColumn(col, lx + i, baseY + treeBaseHeight - 2, lz + j, TREE_TOP_TEX);
+			setInColumn(col, lx + i, baseY + treeBaseHeight, lz + j, TREE_TOP_TEX);
 		}
 	}
 
-	if (rand() % 5 == 0) return;
+	if (rng->nextInt(5) == 0) return;
 
-	quickSet(baseX - 1, baseY + treeBaseHeight + 1, baseZ, TREE_TOP_TEX);
-	quickSet(baseX + 1, baseY + treeBaseHeight + 1, baseZ, TREE_TOP_TEX);
-	quickSet(baseX, baseY + treeBaseHeight + 1, baseZ - 1, TREE_TOP_TEX);
-	quickSet(baseX, baseY + treeBaseHeight + 1, baseZ + 1, TREE_TOP_TEX);
-	quickSet(baseX, baseY + treeBaseHeight + 1, baseZ, TREE_TOP_TEX);
+	setInColumn(col, lx - 1, baseY + treeBaseHeight + 1, lz, TREE_TOP_TEX);
+	setInColumn(col, lx + 1, baseY + treeBaseHeight + 1, lz, TREE_TOP_TEX);
+	setInColumn(col, lx, baseY + treeBaseHeight + 1, lz - 1, TREE_TOP_TEX);
+	setInColumn(col, lx, baseY + treeBaseHeight + 1, lz + 1, TREE_TOP_TEX);
+	setInColumn(col, lx, baseY + treeBaseHeight + 1, lz, TREE_TOP_TEX);
 }
 
-int Terrain::roughness(int x, int z) {
-	const float zoom = 60;
+// trees stand on a TREE_SPACING grid and each one only depends on its own
+// position, so every column it touches places the same tree
+void Terrain::addTrees(ChunkColumn *col) const {
+	int minX = col->getX() * CHUNK_SIZE, minZ = col->getZ() * CHUNK_SIZE;
+	int firstX = MAX(0, minX - TREE_RADIUS + TREE_SPACING - 1) / TREE_SPACING * TREE_SPACING;
+	int firstZ = MAX(0, minZ - TREE_RADIUS + TREE_SPACING - 1) / TREE_SPACING * TREE_SPACING;
+
+	for (int x = firstX; x <= minX + CHUNK_MASK + TREE_RADIUS; x += TREE_SPACING) {
+		for (int z = firstZ; z <= minZ + CHUNK_MASK + TREE_RADIUS; z += TREE_SPACING) {
+			// the same height the column of the tree got from its batch, see noiseBatch()
+			int height;
+			perlinHeights(&x, &z, 1, &height);
+			if (height < (TMAX_Y*0.25f))
+				continue;
 
-	static float freq;
-	static float amp;
-	static int rval = rand();
-	
-	freq = 4;
-	amp = 8;
-	
-	return (int)(noise(((float)x) * freq / zoom, ((float)z) / zoom * freq, rval) * amp);
+			Random rng(Random::cellSeed(seed ^ TREE_SEED, x, z));
+			addTree(col, x - minX, height, z - minZ, &rng);
+		}
+	}
 }
 
-void Terrain::generatePerlinTerrain() {
-	int x, y, z, k, height;
-	DATA_TYPE texNr = 0;
-	float n, freq, amp;
+// for x, z >= 0
+void Terrain::noisePoints(const int *xs, const int *zs, int count, float freq, float zoom, int rval, float *out) {
+	float fx[TILE_SIZE], fz[TILE_SIZE];
+
+	for (int i = 0; i < count; i++) {
+		fx[i] = ((float)xs[i]) * freq / zoom;
+		fz[i] = ((float)zs[i]) / zoom * freq;
+	}
+	noiseBatch(fx, fz, count, rval, out);
+}
 
+void Terrain::roughness(const int *xs, const int *zs, int count, int *out) const {
+	const float zoom = 60;
+	const float freq = 4;
+	const float amp = 8;
+	float n[TILE_SIZE];
+
+	noisePoints(xs, zs, count, freq, zoom, roughnessRval, n);
+	for (int i = 0; i < count; i++) {
+		out[i] = (int)(n[i] * amp);
+	}
+}
+
+// count <= TILE_SIZE
+void Terrain::perlinHeights(const int *xs, const int *zs, int count, int *heights) const {
 	float persistence = 0.3f;
 	float zoom = 90;
 
-	clearTerrain();
-	
-	srand(seed);
-	int rval = rand();
+	int rval = perlinRval;
 
 	zoom -= rval % 10;
 	persistence += (rval % 10) * 0.01f;
 
-	for (x = 0; x < MAX_X; x++) {
-		for (z = 0; z < MAX_Z; z++) {
-			n = 0;
+	float n[TILE_SIZE] = {0}, octave[TILE_SIZE];
+	for (int k = 0; k < NUM_OCTAVES - 1; k++) {
+		float freq = std::pow(2.0f, (float)k);
+		float amp = std::pow(persistence, (float)k);
 
-			for (k = 0; k < NUM_OCTAVES - 1; k++) {
-				freq = std::pow(2.0f, (float)k); // powf?
-				amp = std::pow(persistence, (float)k); // powf?
-				n += noise(((float)x) * freq / zoom, ((float)z) / zoom * freq, rval) * amp;
-			}
+		noisePoints(xs, zs, count, freq, zoom, rval, octave);
+		for (int i = 0; i < count; i++) {
+			n[i] += octave[i] * amp;
+		}
+	}
 
-			height = (int)(n * ((float)TMAX_Y / 2.0f) + (float)TMAX_Y / 2.0f);
-			
-			height += roughness(x, z);
-			
-			height = (height > TMAX_Y) ? TMAX_Y : height;
-			height = (height <= 0) ? 1 : height;
+	roughness(xs, zs, count, heights);
 
-			for (y = 0; y < TMAX_Y; y++) {
-				if (y <= height) {
-					texNr = chooseTexForHeight(y, height);
-					quickSet(x, y, z, texNr);
+	for (int i = 0; i < count; i++) {
+		int height = (int)(n[i] * ((float)TMAX_Y / 2.0f) + (float)TMAX_Y / 2.0f);
+		
+		height += heights[i];
+		
+		height = (height > TMAX_Y) ? TMAX_Y : height;
+		heights[i] = (height <= 0) ? 1 : height;
+	}
+}
 
-					// swiss cheese
-					if (rand() % 20 == 0 && y == height && y > 1) {
-						DATA_TYPE tmp = get(x, y, z);
-						quickSet(x, y, z, 0);
-						quickSet(x, y - 1, z, tmp);
+// false if no block of the section gets a density within [lo, hi], out is left alone then
+bool Terrain::sectionDensity(int minX, int minY, int minZ, float zoom, int rval, float lo, float hi, float *out) {
+	float lattice[CAVE_LATTICE_SIZE];
+	noise3Grid(minX, minY, minZ, CAVE_CELL, CAVE_LATTICE, CAVE_LATTICE, CAVE_LATTICE, zoom, rval, lattice);
+
+	// interpolated values stay within the range of the lattice
+	float minVal = lattice[0], maxVal = lattice[0];
+	for (int i = 1; i < CAVE_LATTICE_SIZE; i++) {
+		minVal = MIN(minVal, lattice[i]);
+		maxVal = MAX(maxVal, lattice[i]);
+	}
+	if (maxVal < lo || minVal > hi)
+		return false;
+
+	interpolateLattice(lattice, out);
+	return true;
+}
+
+// trilinear, one lattice cell after the other, out in ChunkSection::localIndex() order
+void Terrain::interpolateLattice(const float *lattice, float *out) {
+	const int L = CAVE_LATTICE, LL = CAVE_LATTICE * CAVE_LATTICE;
+	const float step = 1.0f / CAVE_CELL;
+
+	for (int ci = 0; ci < L - 1; ci++) {
+		for (int cj = 0; cj < L - 1; cj++) {
+			for (int ck = 0; ck < L - 1; ck++) {
+				const float *c = &lattice[(ci * L + cj) * L + ck];
+
+				for (int i = 0; i < CAVE_CELL; i++) {
+					float fx = i * step;
+					float c00 = c[0] + (c[LL] - c[0]) * fx;
+					float c01 = c[1] + (c[LL + 1] - c[1]) * fx;
+					float c10 = c[L] + (c[LL + L] - c[L]) * fx;
+					float c11 = c[L + 1] + (c[LL + L + 1] - c[L + 1]) * fx;
+
+					for (int j = 0; j < CAVE_CELL; j++) {
+						float fy = j * step;
+						float c0 = c00 + (c10 - c00) * fy;
+						float c1 = c01 + (c11 - c01) * fy;
+
+						int x = ci * CAVE_CELL + i, y = cj * CAVE_CELL + j, z = ck * CAVE_CELL;
+						for (int k = 0; k < CAVE_CELL; k++) {
+							out[ChunkSection::localIndex(x, y, z + k)] = c0 + (c1 - c0) * (k * step);
+						}
 					}
 				}
 			}
+		}
+	}
+}
+
+static inline bool isStoneTex(DATA_TYPE tex) {
+	return tex == TID_BRIGHT_STONE + 1 || tex == TID_DARK_STONE + 1 || tex == TID_STONE_VAR + 1;
+}
+
+// tunnels where two density fields are both close to zero, gold where a third one peaks
+void Terrain::carveCaves(ChunkColumn *col, const int *heights) const {
+	int minX = col->getX() * CHUNK_SIZE, minZ = col->getZ() * CHUNK_SIZE;
+
+	int maxHeight = 0;
+	for (int i = 0; i < TILE_SIZE; i++) {
+		maxHeight = MAX(maxHeight, heights[i]);
+	}
 
-			if (x % 10 == 0 && z % 10 == 0 && height >= (TMAX_Y*0.25f)) {
-				// no trees on water
-				if (texNr != 11) {
-					addTree(x, height, z);
+	float tunnelA[ChunkSection::NUM_VOXELS], tunnelB[ChunkSection::NUM_VOXELS], ore[ChunkSection::NUM_VOXELS];
+
+	// sections above the terrain are air
+	for (int minY = 0; minY <= maxHeight; minY += CHUNK_SIZE) {
+		bool caves = minY <= maxHeight - CAVE_CRUST &&
+			sectionDensity(minX, minY, minZ, CAVE_ZOOM, caveRvals[0], -CAVE_WIDTH, CAVE_WIDTH, tunnelA) &&
+			sectionDensity(minX, minY, minZ, CAVE_ZOOM, caveRvals[1], -CAVE_WIDTH, CAVE_WIDTH, tunnelB);
+		bool ores = sectionDensity(minX, minY, minZ, ORE_ZOOM, oreRval, ORE_DENSITY, FLT_MAX, ore);
+		if (!caves && !ores)
+			continue;
+
+		for (int lx = 0; lx < CHUNK_SIZE; lx++) {
+			for (int ly = 0; ly < CHUNK_SIZE; ly++) {
+				int y = minY + ly;
+				for (int lz = 0; lz < CHUNK_SIZE; lz++) {
+					int i = ChunkSection::localIndex(lx, ly, lz);
+					// the ground floor and the surface stay closed
+					if (caves && y > 0 && y <= heights[lx * CHUNK_SIZE + lz] - CAVE_CRUST &&
+						tunnelA[i] * tunnelA[i] + tunnelB[i] * tunnelB[i] < CAVE_WIDTH * CAVE_WIDTH) {
+						col->set(lx, y, lz, 0);
+					} else if (ores && ore[i] >= ORE_DENSITY && isStoneTex(col->get(lx, y, lz))) {
+						col->set(lx, y, lz, TID_GOLD_STONE + 1);
+					}
 				}
 			}
 		}
 	}
 }
 
-void Terrain::generatePyramidTerrain() {
-	int x, y, z, p, q;
-	int xOffset = MAX_X / 2;
-	int zOffset = MAX_Z / 2;
-	
-	const DATA_TYPE tid = 13;
+void Terrain::generatePerlinTerrain(ChunkColumn *col, Random *rng) const {
+	int minX = col->getX() * CHUNK_SIZE, minZ = col->getZ() * CHUNK_SIZE;
+	int y, height;
+	DATA_TYPE texNr = 0;
 
-	generateFlatTerrain(tid);
+	// all blocks of the column in one batch, index lx * CHUNK_SIZE + lz
+	int xs[TILE_SIZE], zs[TILE_SIZE], heights[TILE_SIZE];
+	for (int i = 0; i < TILE_SIZE; i++) {
+		xs[i] = minX + i / CHUNK_SIZE;
+		zs[i] = minZ + i % CHUNK_SIZE;
+	}
+	perlinHeights(xs, zs, TILE_SIZE, heights);
 
-	for (x = 0; x < MAX_Y; x++) {
-		for (z = 0; z < MAX_Y; z++) {
-			// always fill ground
-			quickSet(x + xOffset, 0, z + zOffset, tid);
+	int numWaterBlocks = 0;
 
-			for (y = 0; y < MAX_Y; y++) {
-				if (x < MAX_Y / 2 && z < MAX_Y / 2) {
-					p = x;
-					q = z;
-					quickSet(x + xOffset, p < q ? p : q, z + zOffset, tid);
-				} else if (x >= MAX_Y / 2 && z >= MAX_Y / 2) {
-					p = MAX_Y - 1 - x;
-					q = MAX_Y - 1 - z;
-					quickSet(x + xOffset, p < q ? p : q, z + zOffset, tid);
-				} else if (x <= MAX_Y / 2 && z >= MAX_Y / 2) {
-					p = x;
-					q = MAX_Y - 1 - z;
-					quickSet(x + xOffset, p < q ? p : q, z + zOffset, tid);
-				} else if (x >= MAX_Y / 2 && z <= MAX_Y / 2) {
-					p = MAX_Y - 1 - x;
-					q = z;
-					quickSet(x + xOffset, p < q ? p : q, z + zOffset, tid);
+	for (int lx = 0; lx < CHUNK_SIZE; lx++) {
+		for (int lz = 0; lz < CHUNK_SIZE; lz++) {
+			height = heights[lx * CHUNK_SIZE + lz];
+
+			for (y = 0; y < TMAX_Y; y++) {
+				if (y <= height) {
+					texNr = chooseTexForHeight(y, height, rng, &numWaterBlocks);
+					col->set(lx, y, lz, texNr);
+
+					// swiss cheese
+					if (rng->nextInt(20) == 0 && y == height && y > 1) {
+						DATA_TYPE tmp = col->get(lx, y, lz);
+						col->set(lx, y, lz, 0);
+						col->set(lx, y - 1, lz, tmp);
+					}
 				}
 			}
 		}
 	}
+
+	carveCaves(col, heights);
+	addTrees(col);
 }
 
-void Terrain::generateFlatTerrain(DATA_TYPE tid) {
-	int x, z;
+void Terrain::generatePyramidTerrain(ChunkColumn *col) const {
+	int minX = col->getX() * CHUNK_SIZE, minZ = col->getZ() * CHUNK_SIZE;
+	int x, z, p, q;
+	int xOffset = spawnX;
+	int zOffset = spawnZ;
+	
+	const DATA_TYPE tid = 13;
 
-	clearTerrain();
+	generateFlatTerrain(col, tid);
+
+	for (int lx = 0; lx < CHUNK_SIZE; lx++) {
+		for (int lz = 0; lz < CHUNK_SIZE; lz++) {
+			x = minX + lx - xOffset;
+			z = minZ + lz - zOffset;
+			if (x < 0 || z < 0 || x >= MAX_Y || z >= MAX_Y)
+				continue;
+
+			if (x < MAX_Y / 2 && z < MAX_Y / 2) {
+				p = x;
+				q = z;
+			} else if (x >= MAX_Y / 2 && z >= MAX_Y / 2) {
+				p = MAX_Y - 1 - x;
+				q = MAX_Y - 1 - z;
+			} else if (x <= MAX_Y / 2 && z >= MAX_Y / 2) {
+				p = x;
+				q = MAX_Y - 1 - z;
+			} else {
+				p = MAX_Y - 1 - x;
+				q = z;
+			}
+			col->set(lx, p < q ? p : q, lz, tid);
+		}
+	}
+}
 
-	for (x = 0; x < MAX_X; x++) {
-		for (z = 0; z < MAX_Z; z++) {
-			quickSet(x, 0, z, tid);
-			quickSet(x, 1, z, tid);
+void Terrain::generateFlatTerrain(ChunkColumn *col, DATA_TYPE tid) {
+	for (int lx = 0; lx < CHUNK_SIZE; lx++) {
+		for (int lz = 0; lz < CHUNK_SIZE; lz++) {
+			col->set(lx, 0, lz, tid);
+			col->set(lx, 1, lz, tid);
 		}
 	}
 }
 
-DATA_TYPE Terrain::randomlyChooseTexId() const {
-	return (DATA_TYPE)(rand() % 64 + 1);
+DATA_TYPE Terrain::randomlyChooseTexId(Random *rng) {
+	return (DATA_TYPE)(rng->nextInt(64) + 1);
 }
 
 int Terrain::numBlocksAbove(int x, int y, int z) const {
+	if (!isValidIndex(x, y, z))
+		return 0;
+
+	// nothing but air above the top height
+	int top = findColumn(x >> CHUNK_SHIFT, z >> CHUNK_SHIFT)->topHeightAt(x & CHUNK_MASK, z & CHUNK_MASK);
 	int nba = 0;
-	for (int k = y + 1; k < MAX_Y; k++) {
-		if (get(x, k, z) != 0 && !isInvisible(get(x, k, z)))
+	for (int k = y + 1; k < top; k++) {
+		if (blockType(get(x, k, z)).mesh != BlockType::MESH_NONE)
 			nba++;
 	}
 	return nba;
 }
 
-bool Terrain::isBlockAbove(int x, int y, int z) const {
-	if (x < 0 || y < 0 || z < 0 || x >= MAX_X || y >= MAX_Y || z >= MAX_Z)
+// a block's faces border the sections above/below and the adjacent columns
+void Terrain::markSectionsDirty(int x, int y, int z) {
+	if ((uint)y >= (uint)MAX_Y) return;
+
+	int cx = x >> CHUNK_SHIFT, cz = z >> CHUNK_SHIFT;
+	int lx = x & CHUNK_MASK, lz = z & CHUNK_MASK;
+	int s = y >> CHUNK_SHIFT;
+
+	dirtySections[ChunkColumn::makeKey(cx, cz)] |= ChunkColumn::sectionsAround(y);
+
+	if (lx == 0)
+		dirtySections[ChunkColumn::makeKey(cx - 1, cz)].set(s);
+	else if (lx == CHUNK_MASK)
+		dirtySections[ChunkColumn::makeKey(cx + 1, cz)].set(s);
+
+	if (lz == 0)
+		dirtySections[ChunkColumn::makeKey(cx, cz - 1)].set(s);
+	else if (lz == CHUNK_MASK)
+		dirtySections[ChunkColumn::makeKey(cx, cz + 1)].set(s);
+}
+
+// the blocks of a batch which changed, for observers which care about single blocks
+void Terrain::markBlockChanged(int x, int y, int z) {
+	if ((uint)y >= (uint)MAX_Y || !isLoaded(x, z)) return;
+
+	BlockPos section(x & ~CHUNK_MASK, y & ~CHUNK_MASK, z & ~CHUNK_MASK);
+	sectionChanges[section].push_back(BlockPos(x, y, z));
+}
+
+void Terrain::commitEdit() {
+	if (editDepth == 0 || --editDepth > 0) return;
+	journal.endAction();
+	notifyDirtySections();
+}
+
+// only blocks which actually changed, columns which aren't resident ignore set()
+void Terrain::journalBlock(int x, int y, int z, DATA_TYPE oldVal, DATA_TYPE newVal) {
+	if (replaying || !journal.isRecording() || get(x, y, z) != newVal)
+		return;
+
+	journal.recordBlock(x, y, z, oldVal, newVal);
+}
+
+bool Terrain::undo() {
+	if (editDepth > 0 || !journal.undo(&journalRecords))
 		return false;
 
-	for (int k = y + 1; k < MAX_Y; k++) {
-		if (get(x, k, z) != 0 && !isInvisible(get(x, k, z)) && get(x,k,z) != (Terrain::FENCE_TEX_INDEX+1))
-			return true;
-	}
-	return false;
+	replayJournal(true);
+	return true;
 }
 
-void Terrain::lazySet(int x, int y, int z, DATA_TYPE val) {
-	set(x, y, z, val);
-	BlockPos bpos(x, y, z);
-	changedBlocks.push_back(bpos);
+bool Terrain::redo() {
+	if (editDepth > 0 || !journal.redo(&journalRecords))
+		return false;
+
+	replayJournal(false);
+	return true;
 }
 
-void Terrain::lazySetFlush() {
-	if (changedBlocks.empty()) return;
+// the records of an action, last one first when undoing
+void Terrain::replayJournal(bool backwards) {
+	replaying = true;
+	beginEdit();
+
+	size_t n = journalRecords.size();
+	for (size_t i = 0; i < n; i++) {
+		const EditJournal::Record &r = journalRecords[backwards ? n - 1 - i : i];
+		if (r.type == EditJournal::BLOCK) {
+			set(r.pos.x, r.pos.y, r.pos.z, backwards ? r.oldVal : r.newVal);
+		} else if ((r.type == EditJournal::ENTITY_ADDED) != backwards) {
+			addEntity(Entity(r.pos.x, r.pos.y, r.pos.z, r.entityType, r.cface));
+		} else {
+			removeEntityAt(r.pos.x, r.pos.y, r.pos.z, r.cface);
+		}
+	}
+
+	commitEdit();
+	replaying = false;
+}
 
-	entityUpdate = false;
+// observers get the origin of each dirty section with isSectionUpdate() set
+// and the blocks changed in it by getSectionChanges()
+void Terrain::notifyDirtySections() {
+	if (dirtySections.empty()) return;
 
-	std::list<BlockPos>::iterator it;
-	for (it = changedBlocks.begin(); it != changedBlocks.end(); ++it) {
-		notifyObservers(&(*it));
+	entityUpdate = false;
+	sectionUpdate = true;
+
+	DirtySectionMap::iterator it;
+	for (it = dirtySections.begin(); it != dirtySections.end(); ++it) {
+		int cx = (int)(it->first >> 32), cz = (int)it->first;
+		for (int s = 0; s < ChunkColumn::NUM_SECTIONS; s++) {
+			if (!it->second.test(s)) continue;
+			BlockPos sectionPos(cx << CHUNK_SHIFT, s << CHUNK_SHIFT, cz << CHUNK_SHIFT);
+			SectionChangeMap::const_iterator changes = sectionChanges.find(sectionPos);
+			reportedChanges = (changes != sectionChanges.end()) ? &changes->second : &NO_CHANGES;
+			notifyObservers(&sectionPos);
+		}
 	}
 
-	changedBlocks.clear();
+	sectionUpdate = false;
+	reportedChanges = &NO_CHANGES;
+	dirtySections.clear();
+	sectionChanges.clear();
 }
 
+// y 0 counts as the block below if there is none above it
 int Terrain::getYOfBlockBelow(int x, int y, int z) const {
-	for (int cy = y - 1; cy > 0; cy--) {
-		if (!isEmptyPos(x, cy, z))
-			return cy;
+	int below = highestSolid(x, 1, y - 1, z);
+	return below > 0 ? below : 0;
+}
+
+int Terrain::highestSolid(int x, int minY, int maxY, int z) const {
+	const int BITS = ChunkColumn::SOLID_WORD_BITS;
+
+	minY = MAX(minY, 0);
+	maxY = MIN(maxY, (int)MAX_Y - 1);
+	const ChunkColumn *col = findColumn(x >> CHUNK_SHIFT, z >> CHUNK_SHIFT);
+	if (!col || minY > maxY)
+		return -1;
+
+	const ChunkColumn::SolidWord *words = col->getSolidWords(x & CHUNK_MASK, z & CHUNK_MASK);
+	for (int w = maxY / BITS; w >= minY / BITS; w--) {
+		ChunkColumn::SolidWord bits = words[w];
+		if (w == maxY / BITS && maxY % BITS != BITS - 1)
+			bits &= ((ChunkColumn::SolidWord)2 << (maxY % BITS)) - 1;
+		if (w == minY / BITS)
+			bits &= ~(ChunkColumn::SolidWord)0 << (minY % BITS);
+		if (bits)
+			return w * BITS + highestBit(bits);
 	}
-	return 0;
+	return -1;
 }
 
 float Terrain::calcDensityAroundPos(int x, int y, int z, int envSize) const {
-	float density = 0.0f;
-	for (int xc = x - envSize; xc <= x + envSize; xc++) {
-		for (int yc = y - envSize; yc <= y + envSize; yc++) {
-			for (int zc = z - envSize; zc <= z + envSize; zc++) {
-				if (!isEmptyPos(xc, yc, zc))
-					density++;
+	float density = (float)countSolid(x - envSize, y - envSize, z - envSize, x + envSize, y + envSize, z + envSize);
+	density /= ((envSize * 2 + 1) * (envSize * 2 + 1) * (envSize * 2 + 1));
+	return density;
+}
+
+// 8 lookups per column the box overlaps
+int Terrain::countSolid(int minX, int minY, int minZ, int maxX, int maxY, int maxZ) const {
+	const int SX = (MAX_Y + 1) * (CHUNK_SIZE + 1), SY = CHUNK_SIZE + 1;
+	int count = 0;
+
+	minY = MAX(minY, 0);
+	maxY = MIN(maxY, (int)MAX_Y - 1);
+	if (minY > maxY)
+		return 0;
+
+	for (int cx = minX >> CHUNK_SHIFT; cx <= (maxX >> CHUNK_SHIFT); cx++) {
+		for (int cz = minZ >> CHUNK_SHIFT; cz <= (maxZ >> CHUNK_SHIFT); cz++) {
+			ChunkColumn *col = findColumn(cx, cz);
+			if (!col) continue;
+
+			const uint *sums = solidSumsOf(col).data();
+			int x0 = MAX(minX - (cx << CHUNK_SHIFT), 0), x1 = MIN(maxX - (cx << CHUNK_SHIFT), (int)CHUNK_MASK) + 1;
+			int z0 = MAX(minZ - (cz << CHUNK_SHIFT), 0), z1 = MIN(maxZ - (cz << CHUNK_SHIFT), (int)CHUNK_MASK) + 1;
+			int y0 = minY, y1 = maxY + 1;
+
+			count += sums[x1*SX + y1*SY + z1] - sums[x0*SX + y1*SY + z1]
+				   - sums[x1*SX + y0*SY + z1] - sums[x1*SX + y1*SY + z0]
+				   + sums[x0*SX + y0*SY + z1] + sums[x0*SX + y1*SY + z0]
+				   + sums[x1*SX + y0*SY + z0] - sums[x0*SX + y0*SY + z0];
+		}
+	}
+	return count;
+}
+
+// rebuilt once the column's solid bits changed since the last query,
+// only the MAX_SUMMED_COLUMNS last built tables are kept
+const std::vector<uint> &Terrain::solidSumsOf(ChunkColumn *col) const {
+	const int SX = (MAX_Y + 1) * (CHUNK_SIZE + 1), SY = CHUNK_SIZE + 1;
+	std::vector<uint> &sums = col->getSolidSums();
+	if (!sums.empty())
+		return sums;
+
+	while (summedColumns.size() >= MAX_SUMMED_COLUMNS) {
+		ChunkColumn *oldest = findColumn((int)(summedColumns.front() >> 32), (int)summedColumns.front());
+		if (oldest && oldest != col)
+			oldest->invalidateSolidSums();
+		summedColumns.pop_front();
+	}
+	summedColumns.push_back(col->getKey());
+
+	sums.assign((CHUNK_SIZE + 1) * SX, 0);
+
+	for (int lx = 0; lx < CHUNK_SIZE; lx++) {
+		for (int y = 0; y < MAX_Y; y++) {
+			for (int lz = 0; lz < CHUNK_SIZE; lz++) {
+				int solid = col->isSolid(lx, y, lz);
+				int i = (lx + 1)*SX + (y + 1)*SY + lz + 1;
+
+				sums[i] = solid + sums[i - SX] + sums[i - SY] + sums[i - 1]
+						  - sums[i - SX - SY] - sums[i - SX - 1] - sums[i - SY - 1]
+						  + sums[i - SX - SY - 1];
 			}
 		}
 	}
-	density /= ((envSize * 2 + 1) * (envSize * 2 + 1) * (envSize * 2 + 1));
-	return density;
+	return sums;
 }
 
-bool Terrain::addEntity(Entity entity) {
-	std::list<Entity>::iterator it;
-	bool alreadyExists = false;
+// doors are two blocks high, the door entity sits in the lower one
+void Terrain::updateDoorBits(int x, int y, int z) {
+	ChunkColumn *col = findColumn(x >> CHUNK_SHIFT, z >> CHUNK_SHIFT);
+	if (!col) return;
 
-	// make sure this entity isn't already part of our entity list
-	for (it = entities.begin(); it != entities.end(); ++it) {
-		if ((*it) == entity) {
-			alreadyExists = true;
-			break;
+	for (int dy = y; dy <= y + 1 && dy < MAX_Y; dy++) {
+		if (dy < 0 || col->get(x & CHUNK_MASK, dy, z & CHUNK_MASK) != INVIS_DOOR) continue;
+		col->setSolid(x & CHUNK_MASK, dy, z & CHUNK_MASK, !openDoorAt(x, dy, z));
+	}
+}
+
+// columns only know their blocks, the doors' state is in the entities
+void Terrain::resolveOpenDoors(const std::vector<ChunkColumn *> &cols) {
+	for (size_t i = 0; i < cols.size(); i++) {
+		EntityIndex::const_iterator chunk = entities.find(cols[i]->getKey());
+		if (chunk == entities.end())
+			continue;
+
+		EntityCells::const_iterator cell;
+		for (cell = chunk->second.begin(); cell != chunk->second.end(); ++cell) {
+			if (hasOpenDoor(&cell->second))
+				updateDoorBits(cell->first.x, cell->first.y, cell->first.z);
 		}
 	}
+}
+
+//===========================================================================
+// Light
+//===========================================================================
+void Terrain::setLightAt(int x, int y, int z, LightChannel ch, int level) {
+	ChunkColumn *col = findColumn(x >> CHUNK_SHIFT, z >> CHUNK_SHIFT);
+	if (!col || (uint)y >= (uint)MAX_Y) return;
+
+	int lx = x & CHUNK_MASK, lz = z & CHUNK_MASK;
+	uchar light = col->getLight(lx, y, lz) & ~(ChunkColumn::MAX_LIGHT << ch);
+	col->setLight(lx, y, lz, (uchar)(light | (level << ch)));
+	markSectionsDirty(x, y, z);
+}
 
-	if (!alreadyExists) {
-		entities.push_back(entity);
-		SAFE_DELETE(lastEntity);
-		lastEntity = new Entity(entity);
-		entityUpdate = true;
-		notifyObservers(&entity.pos);
+// sky light of a column on its own: full straight down to the sky height map,
+// spread sideways and down from there. Light from the neighbours and torches
+// is added by lightColumns() once the column is resident. May run on any thread.
+void Terrain::computeColumnLight(ChunkColumn *col) {
+	const int SHIFT = SKY_LIGHT;
+	LightQueue queue;
 
-		// torches light up surrounding area
-		if (entity.type == Entity::TORCH) {
-			entityUpdate = false;
-			notifyObservers(&entity.pos);
+	col->clearLight();
+
+	for (int lx = 0; lx < CHUNK_SIZE; lx++) {
+		for (int lz = 0; lz < CHUNK_SIZE; lz++) {
+			int sky = col->skyHeightAt(lx, lz);
+			for (int y = 0; y < sky; y++) {
+				col->setLight(lx, y, lz, 0);
+			}
+
+			// lights the heights at which a neighbour is shadowed
+			int maxSky = sky;
+			for (int d = 0; d < 6; d++) {
+				int nlx = lx + LIGHT_DIRS[d][0], nlz = lz + LIGHT_DIRS[d][2];
+				if (LIGHT_DIRS[d][1] == 0 && (uint)nlx < (uint)CHUNK_SIZE && (uint)nlz < (uint)CHUNK_SIZE)
+					maxSky = MAX(maxSky, (int)col->skyHeightAt(nlx, nlz));
+			}
+			for (int y = sky; y < maxSky; y++) {
+				LightNode node = { lx, y, lz, 0 };
+				queue.push_back(node);
+			}
 		}
+	}
 
-		return true;
+	for (size_t i = 0; i < queue.size(); i++) {
+		LightNode node = queue[i];
+		int level = (col->getLight(node.x, node.y, node.z) >> SHIFT) - 1;
+		if (level <= 0) continue;
+
+		for (int d = 0; d < 6; d++) {
+			LightNode next = { node.x + LIGHT_DIRS[d][0], node.y + LIGHT_DIRS[d][1], node.z + LIGHT_DIRS[d][2], 0 };
+			if ((uint)next.x >= (uint)CHUNK_SIZE || (uint)next.y >= (uint)MAX_Y || (uint)next.z >= (uint)CHUNK_SIZE)
+				continue;
+			if ((col->getLight(next.x, next.y, next.z) >> SHIFT) >= level || castsShadow(col->get(next.x, next.y, next.z)))
+				continue;
+
+			col->setLight(next.x, next.y, next.z, (uchar)(level << SHIFT));
+			queue.push_back(next);
+		}
 	}
+}
 
-	return false;
+// joins the light of columns which just became resident with their
+// neighbours' and lights up their torches
+void Terrain::lightColumns(const std::vector<ChunkColumn *> &cols) {
+	LightQueue sky, block;
+
+	// a lights b across a column border
+	auto seed = [&](int ax, int y, int az, int bx, int bz) {
+		if (castsShadow(get(bx, y, bz))) return;
+
+		LightNode node = { ax, y, az, 0 };
+		if (lightAt(ax, y, az, SKY_LIGHT) > lightAt(bx, y, bz, SKY_LIGHT) + 1)
+			sky.push_back(node);
+		if (lightAt(ax, y, az, BLOCK_LIGHT) > lightAt(bx, y, bz, BLOCK_LIGHT) + 1)
+			block.push_back(node);
+	};
+
+	for (size_t i = 0; i < cols.size(); i++) {
+		int cx = cols[i]->getX(), cz = cols[i]->getZ();
+		int x0 = cx << CHUNK_SHIFT, z0 = cz << CHUNK_SHIFT;
+		int x1 = x0 + CHUNK_SIZE - 1, z1 = z0 + CHUNK_SIZE - 1;
+		bool left = findColumn(cx - 1, cz) != NULL, right = findColumn(cx + 1, cz) != NULL;
+		bool back = findColumn(cx, cz - 1) != NULL, front = findColumn(cx, cz + 1) != NULL;
+
+		for (int k = 0; k < CHUNK_SIZE; k++) {
+			for (int y = 0; y < MAX_Y; y++) {
+				if (left) {
+					seed(x0, y, z0 + k, x0 - 1, z0 + k);
+					seed(x0 - 1, y, z0 + k, x0, z0 + k);
+				}
+				if (right) {
+					seed(x1, y, z0 + k, x1 + 1, z0 + k);
+					seed(x1 + 1, y, z0 + k, x1, z0 + k);
+				}
+				if (back) {
+					seed(x0 + k, y, z0, x0 + k, z0 - 1);
+					seed(x0 + k, y, z0 - 1, x0 + k, z0);
+				}
+				if (front) {
+					seed(x0 + k, y, z1, x0 + k, z1 + 1);
+					seed(x0 + k, y, z1 + 1, x0 + k, z1);
+				}
+			}
+		}
+
+		EntityIndex::const_iterator chunk = entities.find(cols[i]->getKey());
+		if (chunk == entities.end())
+			continue;
+
+		EntityCells::const_iterator cell;
+		for (cell = chunk->second.begin(); cell != chunk->second.end(); ++cell) {
+			const BlockPos &pos = cell->first;
+			if (!hasTorchAt(pos.x, pos.y, pos.z) || castsShadow(get(pos.x, pos.y, pos.z))
+					|| lightAt(pos.x, pos.y, pos.z, BLOCK_LIGHT) >= TORCH_LIGHT)
+				continue;
+
+			setLightAt(pos.x, pos.y, pos.z, BLOCK_LIGHT, TORCH_LIGHT);
+			LightNode node = { pos.x, pos.y, pos.z, 0 };
+			block.push_back(node);
+		}
+	}
+
+	spreadLight(&sky, SKY_LIGHT);
+	spreadLight(&block, BLOCK_LIGHT);
+}
+
+// relights around a block which was just set, oldSky is the sky height at x/z before
+void Terrain::updateLight(int x, int y, int z, int oldSky) {
+	static const LightChannel CHANNELS[2] = { SKY_LIGHT, BLOCK_LIGHT };
+
+	if ((uint)y >= (uint)MAX_Y || oldSky < 0) return;
+
+	int sky = skyHeightAt(x, z);
+	bool opaque = castsShadow(get(x, y, z));
+
+	for (int c = 0; c < 2; c++) {
+		LightChannel ch = CHANNELS[c];
+		LightQueue darkened, sources;
+
+		if (opaque) {
+			// the block swallows the light it was lit with
+			LightNode node = { x, y, z, lightAt(x, y, z, ch) };
+			if (node.level > 0) {
+				setLightAt(x, y, z, ch, 0);
+				darkened.push_back(node);
+			}
+		} else {
+			// the neighbours light it up again
+			for (int d = 0; d < 6; d++) {
+				LightNode node = { x + LIGHT_DIRS[d][0], y + LIGHT_DIRS[d][1], z + LIGHT_DIRS[d][2], 0 };
+				if (lightAt(node.x, node.y, node.z, ch) > 1)
+					sources.push_back(node);
+			}
+		}
+
+		if (ch == SKY_LIGHT) {
+			// open to the sky now
+			for (int ny = sky; ny < oldSky; ny++) {
+				if (lightAt(x, ny, z, ch) == ChunkColumn::MAX_LIGHT) continue;
+				setLightAt(x, ny, z, ch, ChunkColumn::MAX_LIGHT);
+				LightNode node = { x, ny, z, 0 };
+				sources.push_back(node);
+			}
+
+			// below a new roof, the block itself was handled above
+			for (int ny = oldSky; ny < sky - 1; ny++) {
+				LightNode node = { x, ny, z, lightAt(x, ny, z, ch) };
+				if (node.level == 0) continue;
+				setLightAt(x, ny, z, ch, 0);
+				darkened.push_back(node);
+			}
+		} else if (!opaque && hasTorchAt(x, y, z) && lightAt(x, y, z, ch) < TORCH_LIGHT) {
+			setLightAt(x, y, z, ch, TORCH_LIGHT);
+			LightNode node = { x, y, z, 0 };
+			sources.push_back(node);
+		}
+
+		unspreadLight(&darkened, ch, &sources);
+		spreadLight(&sources, ch);
+	}
+}
+
+void Terrain::addTorchLight(int x, int y, int z) {
+	if (!isValidIndex(x, y, z) || castsShadow(get(x, y, z)) || lightAt(x, y, z, BLOCK_LIGHT) >= TORCH_LIGHT)
+		return;
+
+	setLightAt(x, y, z, BLOCK_LIGHT, TORCH_LIGHT);
+	LightQueue queue;
+	LightNode node = { x, y, z, 0 };
+	queue.push_back(node);
+	spreadLight(&queue, BLOCK_LIGHT);
+}
+
+void Terrain::removeTorchLight(int x, int y, int z) {
+	LightNode node = { x, y, z, lightAt(x, y, z, BLOCK_LIGHT) };
+	if (node.level == 0)
+		return;
+
+	LightQueue darkened, sources;
+	setLightAt(x, y, z, BLOCK_LIGHT, 0);
+	darkened.push_back(node);
+	unspreadLight(&darkened, BLOCK_LIGHT, &sources);
+	spreadLight(&sources, BLOCK_LIGHT);
+}
+
+// breadth first from the queued blocks, each step one level darker
+void Terrain::spreadLight(LightQueue *queue, LightChannel ch) {
+	for (size_t i = 0; i < queue->size(); i++) {
+		LightNode node = (*queue)[i];
+		// may have been darkened or lit brighter since it was queued
+		int level = lightAt(node.x, node.y, node.z, ch) - 1;
+		if (level <= 0) continue;
+
+		for (int d = 0; d < 6; d++) {
+			LightNode next = { node.x + LIGHT_DIRS[d][0], node.y + LIGHT_DIRS[d][1], node.z + LIGHT_DIRS[d][2], 0 };
+			if ((uint)next.y >= (uint)MAX_Y || !isLoaded(next.x, next.z))
+				continue;
+			if (lightAt(next.x, next.y, next.z, ch) >= level || castsShadow(get(next.x, next.y, next.z)))
+				continue;
+
+			setLightAt(next.x, next.y, next.z, ch, level);
+			queue->push_back(next);
+		}
+	}
+}
+
+// darkens everything lit through the queued blocks (level is what they were
+// lit with), the blocks lit from elsewhere bordering on the darkened area go
+// to sources for spreadLight() to fill it in again
+void Terrain::unspreadLight(LightQueue *queue, LightChannel ch, LightQueue *sources) {
+	for (size_t i = 0; i < queue->size(); i++) {
+		LightNode node = (*queue)[i];
+
+		for (int d = 0; d < 6; d++) {
+			LightNode next = { node.x + LIGHT_DIRS[d][0], node.y + LIGHT_DIRS[d][1], node.z + LIGHT_DIRS[d][2], 0 };
+			next.level = lightAt(next.x, next.y, next.z, ch);
+			if (next.level == 0) continue;
+
+			if (next.level < node.level) {
+				setLightAt(next.x, next.y, next.z, ch, 0);
+				queue->push_back(next);
+			} else {
+				sources->push_back(next);
+			}
+		}
+	}
+}
+
+//===========================================================================
+// Entities
+//===========================================================================
+const Terrain::EntityCell *Terrain::findEntityCell(int x, int y, int z) const {
+	EntityIndex::const_iterator chunk = entities.find(ChunkColumn::makeKey(x >> CHUNK_SHIFT, z >> CHUNK_SHIFT));
+	if (chunk == entities.end())
+		return NULL;
+
+	EntityCells::const_iterator cell = chunk->second.find(BlockPos(x, y, z));
+	return (cell != chunk->second.end()) ? &cell->second : NULL;
+}
+
+bool Terrain::addEntity(Entity entity) {
+	EntityCell &cell = entities[ChunkColumn::makeKey(entity.pos.x >> CHUNK_SHIFT, entity.pos.z >> CHUNK_SHIFT)][entity.pos];
+
+	// make sure this entity isn't already part of our entity index
+	for (size_t i = 0; i < cell.size(); i++) {
+		if (cell[i] == entity)
+			return false;
+	}
+
+	cell.push_back(entity);
+	numEntities++;
+	entitiesModified = true;
+	if (!replaying)
+		journal.recordEntity(EditJournal::ENTITY_ADDED, entity);
+	if (Entity::isDoorIndex(entity.type))
+		updateDoorBits(entity.pos.x, entity.pos.y, entity.pos.z);
+
+	SAFE_DELETE(lastEntity);
+	lastEntity = new Entity(entity);
+	entityUpdate = true;
+	notifyObservers(&entity.pos);
+
+	// torches light up surrounding area
+	if (entity.type == Entity::TORCH) {
+		addTorchLight(entity.pos.x, entity.pos.y, entity.pos.z);
+		if (editDepth == 0)
+			notifyDirtySections();
+	}
+
+	return true;
 }
 
 std::list<Entity> Terrain::getEntitiesInArea(int minX, int maxX, int minZ, int maxZ, int *numGlass, int *numStanding, int *numDoors) const {
-	std::list<Entity>::const_iterator it;
-	const BlockPos *bpos;
 	std::list<Entity> eia;
-	for (it = entities.begin(); it != entities.end(); ++it) {
-		//if((*it).type == ENTITY_RAIL) continue;
-
-		bpos = &(*it).pos;
-		if (bpos->x >= minX && bpos->x <= maxX && bpos->z >= minZ && bpos->z <= maxZ) {
-			eia.push_back(*it);
-			Entity::EntityType etype = (*it).type;
-			if (etype == Entity::GLASS) {
-				(*numGlass)++;
-			} else if (etype == Entity::FLOWER || etype == Entity::MUSHROOM
-					   || (etype == Entity::TORCH && (*it).cface == CF_TOP)) {
-				(*numStanding)++;
-			} else if (Entity::isDoorIndex(etype)) {
-				(*numDoors)++;
+
+	for (int cx = minX >> CHUNK_SHIFT; cx <= (maxX >> CHUNK_SHIFT); cx++) {
+		for (int cz = minZ >> CHUNK_SHIFT; cz <= (maxZ >> CHUNK_SHIFT); cz++) {
+			EntityIndex::const_iterator chunk = entities.find(ChunkColumn::makeKey(cx, cz));
+			if (chunk == entities.end())
+				continue;
+
+			EntityCells::const_iterator cell;
+			for (cell = chunk->second.begin(); cell != chunk->second.end(); ++cell) {
+				const BlockPos *bpos = &cell->first;
+				if (bpos->x < minX || bpos->x > maxX || bpos->z < minZ || bpos->z > maxZ)
+					continue;
+
+				for (size_t i = 0; i < cell->second.size(); i++) {
+					const Entity &e = cell->second[i];
+					eia.push_back(e);
+					Entity::EntityType etype = e.type;
+					if (etype == Entity::GLASS) {
+						(*numGlass)++;
+					} else if (etype == Entity::FLOWER || etype == Entity::MUSHROOM
+							   || (etype == Entity::TORCH && e.cface == CF_TOP)) {
+						(*numStanding)++;
+					} else if (Entity::isDoorIndex(etype)) {
+						(*numDoors)++;
+					}
+				}
 			}
 		}
 	}
@@ -575,69 +1622,83 @@ std::list<Entity> Terrain::getEntitiesInArea(int minX, int maxX, int minZ, int m
 }
 
 bool Terrain::removeEntityAt(int x, int y, int z, CubeFace cface) {
-	bool dontRemBlock = false;
-	std::list<Entity>::iterator it;
+	EntityIndex::iterator chunk = entities.find(ChunkColumn::makeKey(x >> CHUNK_SHIFT, z >> CHUNK_SHIFT));
+	if (chunk == entities.end())
+		return false;
+
 	BlockPos dpos(x, y, z);
+	EntityCells::iterator cellIt = chunk->second.find(dpos);
+	if (cellIt == chunk->second.end())
+		return false;
 
-	for (it = entities.begin(); it != entities.end();) {
-		if ((*it).pos == dpos) {
-			dontRemBlock = true;
+	EntityCell &cell = cellIt->second;
+	bool removedTorch = false;
 
-			if ((*it).cface == cface || cface == (CubeFace)23) {
-				deleteEntity = true;
-				SAFE_DELETE(lastEntity);
-				lastEntity = new Entity(*it);
+	for (size_t i = 0; i < cell.size();) {
+		if (cell[i].cface == cface || cface == (CubeFace)23) {
+			if (!replaying)
+				journal.recordEntity(EditJournal::ENTITY_REMOVED, cell[i]);
 
-				entityUpdate = true;
-				notifyObservers(&dpos);
+			deleteEntity = true;
+			SAFE_DELETE(lastEntity);
+			lastEntity = new Entity(cell[i]);
 
-				// torches light up surrounding area
-				if ((*it).type == Entity::TORCH) {
-					entityUpdate = false;
-					notifyObservers(&dpos);
-				}
+			entityUpdate = true;
+			notifyObservers(&dpos);
 
-				entities.erase(it++);
-				deleteEntity = false;
+			if (cell[i].type == Entity::TORCH)
+				removedTorch = true;
+			cell.erase(cell.begin() + i);
+			numEntities--;
+			entitiesModified = true;
+			deleteEntity = false;
 
-				continue;
-			}
+			continue;
 		}
-		++it;
+		++i;
 	}
 
-	return dontRemBlock;
-}
 
-float Terrain::distToNearestLight(float x, float y, float z) const {
-	std::list<Entity>::const_iterator it;
-	const Entity *et;
-	float minDist = (float)TERRAIN_SIZE, dst;
-	for (it = entities.begin(); it != entities.end(); ++it) {
-		et = &(*it);
-		if (et->type != Entity::TORCH) continue;
+	if (cell.empty()) {
+		chunk->second.erase(cellIt);
+		if (chunk->second.empty())
+			entities.erase(chunk);
+	}
 
-		if (et->cface == CF_LEFT && x > et->pos.x) continue;
-		if (et->cface == CF_RIGHT && x < et->pos.x) continue;
-		if (et->cface == CF_FRONT && z < et->pos.z) continue;
-		if (et->cface == CF_BACK && z > et->pos.z) continue;
+	updateDoorBits(x, y, z);
 
-		dst = LDIST(et->pos, x, y, z);
-		if (dst < minDist)
-			minDist = dst;
+	// torches light up surrounding area
+	if (removedTorch && !hasTorchAt(x, y, z)) {
+		removeTorchLight(x, y, z);
+		if (editDepth == 0)
+			notifyDirtySections();
 	}
 
-	return minDist;
+	// there was an entity at this position
+	return true;
+}
+
+bool Terrain::hasTorchAt(int x, int y, int z) const {
+	const EntityCell *cell = findEntityCell(x, y, z);
+	if (!cell)
+		return false;
+
+	for (size_t i = 0; i < cell->size(); i++) {
+		if ((*cell)[i].type == Entity::TORCH)
+			return true;
+	}
+	return false;
 }
 
 std::list<Entity> Terrain::getEntitiesAtPos(int x, int y, int z, Entity::EntityType type) const {
-	std::list<Entity>::const_iterator it;
-	BlockPos dpos(x, y, z);
 	std::list<Entity> eap;
+	const EntityCell *cell = findEntityCell(x, y, z);
+	if (!cell)
+		return eap;
 
-	for (it = entities.begin(); it != entities.end(); ++it) {
-		if ((*it).pos == dpos && ((*it).type == type || type == (Entity::EntityType)23)) {
-			eap.push_back((*it));
+	for (size_t i = 0; i < cell->size(); i++) {
+		if ((*cell)[i].type == type || type == (Entity::EntityType)23) {
+			eap.push_back((*cell)[i]);
 		}
 	}
 
@@ -645,46 +1706,61 @@ std::list<Entity> Terrain::getEntitiesAtPos(int x, int y, int z, Entity::EntityT
 }
 
 bool Terrain::hasLadderOnFace(int x, int y, int z, CubeFace face) const {
-	std::list<Entity>::const_iterator it;
-	BlockPos dpos(x, y, z);
-	for (it = entities.begin(); it != entities.end(); ++it) {
-		if ((*it).pos == dpos && (*it).type == Entity::LADDER && (*it).cface == face) {
+	const EntityCell *cell = findEntityCell(x, y, z);
+	if (!cell)
+		return false;
+
+	for (size_t i = 0; i < cell->size(); i++) {
+		if ((*cell)[i].type == Entity::LADDER && (*cell)[i].cface == face) {
 			return true;
 		}
 	}
 	return false;
 }
 
-bool Terrain::openDoorAt(int x, int y, int z) const {
-	std::list<Entity> eap = getEntitiesAtPos(x, y, z);
-	std::list<Entity> eapBelow = getEntitiesAtPos(x, y - 1, z);
-	std::list<Entity>::const_iterator it;
-
-	for (it = eap.begin(); it != eap.end(); ++it) {
-		if ((*it).type == Entity::DOOR_X_OPEN ||
-				(*it).type == Entity::DOOR_Z_OPEN)
-			return true;
-	}
+inline bool Terrain::hasOpenDoor(const EntityCell *cell) {
+	if (!cell)
+		return false;
 
-	for (it = eapBelow.begin(); it != eapBelow.end(); ++it) {
-		if ((*it).type == Entity::DOOR_X_OPEN ||
-				(*it).type == Entity::DOOR_Z_OPEN)
+	for (size_t i = 0; i < cell->size(); i++) {
+		if ((*cell)[i].type == Entity::DOOR_X_OPEN || (*cell)[i].type == Entity::DOOR_Z_OPEN)
 			return true;
 	}
-
 	return false;
 }
 
+// doors are two blocks high, the door entity sits in the lower one
+bool Terrain::openDoorAt(int x, int y, int z) const {
+	return hasOpenDoor(findEntityCell(x, y, z)) || hasOpenDoor(findEntityCell(x, y - 1, z));
+}
+
 std::list<Entity> Terrain::getEntitiesOfType( Entity::EntityType etype ) const
 {
 	std::list<Entity> result;
-	std::list<Entity>::const_iterator it;
-	for(it = entities.begin(); it != entities.end(); ++it) {
-		if((*it).type == etype) 
-			result.push_back((*it));
+	EntityIndex::const_iterator chunk;
+	for(chunk = entities.begin(); chunk != entities.end(); ++chunk) {
+		EntityCells::const_iterator cell;
+		for(cell = chunk->second.begin(); cell != chunk->second.end(); ++cell) {
+			for(size_t i = 0; i < cell->second.size(); i++) {
+				if(cell->second[i].type == etype)
+					result.push_back(cell->second[i]);
+			}
+		}
 	}
 
 	return result;
 }
 
+std::list<Entity> Terrain::getAllEntities() const {
+	std::list<Entity> result;
+	EntityIndex::const_iterator chunk;
+	for (chunk = entities.begin(); chunk != entities.end(); ++chunk) {
+		EntityCells::const_iterator cell;
+		for (cell = chunk->second.begin(); cell != chunk->second.end(); ++cell) {
+			result.insert(result.end(), cell->second.begin(), cell->second.end());
+		}
+	}
+	return result;
+}
+
 } /* namespace as */
@@ -3,31 +3,54 @@
 #ifndef TERRAIN_HPP_
 #define TERRAIN_HPP_
 
+#include <atomic>
+#include <climits>
+#include <deque>
 #include <list>
 #include <string>
 #include <map>
+#include <thread>
+#include <unordered_map>
+#include <vector>
 
 #include "Framework/Math/Vector.hpp"
 
 #include "Framework/Observable.hpp"
+#include "Framework/ThreadPool.hpp"
 #include "Framework/Camera.hpp"
 
 #include "BlockPos.hpp"
+#include "BlockTypes.hpp"
 #include "VisibleFaces.hpp"
 #include "Entity.hpp"
+#include "ChunkColumn.hpp"
+#include "EditJournal.hpp"
+#include "WorldRegions.hpp"
+#include "WorldSnapshot.hpp"
 
 //===========================================================================
 // Constants/Macros
 //===========================================================================
 namespace as {
 
-typedef uchar DATA_TYPE;
-
 extern int nblocks_near;
+// how far away blocks can be picked
+extern int nearDist;
+
+class Random;
 
 //===========================================================================
 // Types
 //===========================================================================
+// result of Terrain::raycast()
+struct BlockHit {
+	BlockPos pos;
+	// the face the ray entered pos through
+	CubeFace face;
+	// along the ray up to that face
+	float dist;
+};
+
 class Terrain : public Observable<BlockPos> {
 public:
 	enum TerrainSource {
@@ -44,12 +67,39 @@ public:
 	virtual ~Terrain();
 
 	// terrain persistency
+	void loadTerrain(const WorldFile &file, const char *filename);
+	void loadEntities(const WorldFile &file);
+	void saveTerrainToFile(const char *filename = NULL);
+	static void deleteWorldFiles(const char *filename);
+
+	// worlds of older versions, converted by their next save
 	void loadTerrainFromFile(const char *filename = NULL);
-	void saveTerrainToFile(const char *filename = NULL) const;
 	void loadEntitiesFromFile(const char *filename);
-	void saveEntitiesToFile(const char *filename) const;
 
-	void blocksNear(Camera *cam, std::list<BlockPos> *blocksNear) const;
+	// background saving: only one snapshot is written at a time
+	void addTerrainToSnapshot(WorldSnapshot *snapshot, const char *filename = NULL);
+	void addEntitiesToSnapshot(WorldSnapshot *snapshot);
+	void writeInBackground(WorldSnapshot *snapshot);
+	void finishSave();
+	bool isSaving() const;
+	// blocks or entities changed since the last snapshot
+	bool hasUnsavedChanges() const;
+
+	// column streaming: requestColumnsAround() queues the missing columns near to far,
+	// streamColumns() makes up to maxColumns of them resident and returns how many
+	void loadColumnsAround(int cx, int cz, int radius);
+	void requestColumnsAround(int cx, int cz, int radius);
+	int streamColumns(int maxColumns);
+	bool hasPendingColumns() const;
+	// the column and the ones around it are resident, columns beyond the world's edge don't count
+	bool hasColumnsAround(int cx, int cz) const;
+	bool isLoaded(int x, int z) const;
+	int getLoadRadius() const;
+	int getSpawnX() const;
+	int getSpawnZ() const;
+
+	// first non empty block within maxDist along the ray, dir of unit length
+	bool raycast(const Vec3 &origin, const Vec3 &dir, float maxDist, BlockHit *hit) const;
 
 	VisibleFaces determineVisibleFaces(int x, int y, int z) const;
 	bool isValidIndex(int x, int y, int z) const;
@@ -57,31 +107,53 @@ public:
 	// terrain data (voxels) related methods
 	DATA_TYPE get(int x, int y, int z) const;
 	DATA_TYPE getValid(int x, int y, int z) const;
-	DATA_TYPE *getDataPtr();
+	void exportBlocks(DATA_TYPE *dest) const;
+	void importBlocks(const DATA_TYPE *src);
+	size_t memoryUsage() const;
 
 	void set(int x, int y, int z, DATA_TYPE val);
 	void quickSet(int x, int y, int z, DATA_TYPE val);
-	void lazySet(int x, int y, int z, DATA_TYPE val);
-	void lazySetFlush();
+
+	// edit batches (may nest): set() only marks the touched sections dirty until
+	// the outermost commitEdit(), which notifies once per dirty section.
+	// The outermost batch is one action for undo() unless it isn't undoable
+	// (simulations, remote players), edits outside of batches (loading, ...) aren't journaled.
+	void beginEdit(bool undoable = true);
+	void commitEdit();
+	bool isSectionUpdate() const;
+	// blocks the batch set within the reported section, empty if only light or neighbours changed it
+	const std::vector<BlockPos> &getSectionChanges() const;
+
+	// revert or reapply an action as one edit batch, false if there is none
+	bool undo();
+	bool redo();
 
 	bool isEmptyPos(int x, int y, int z) const;
 	bool isEmptyPos(float x, float y, float z) const;
 	bool isEmptyPos(Vec3 v) const;
+	// through the columns' solid bits, a word operation per ChunkColumn::SOLID_WORD_BITS blocks
+	bool isEmptySpan(int x, int minY, int maxY, int z) const;
+	// highest y within minY..maxY which isn't isEmptyPos(), -1 if there is none
+	int highestSolid(int x, int minY, int maxY, int z) const;
+
+	// sky light << ChunkColumn::SKY_LIGHT_SHIFT | block light, full sky light outside of resident columns
+	uchar getLight(int x, int y, int z) const;
 
 	int numBlocksAbove(int x, int y, int z) const;
 	bool isBlockAbove(int x, int y, int z) const;
 	int getYOfBlockBelow(int x, int y, int z) const;
 	float calcDensityAroundPos(int x, int y, int z, int envSize) const;
+	// blocks in the box (bounds included) which aren't isEmptyPos()
+	int countSolid(int minX, int minY, int minZ, int maxX, int maxY, int maxZ) const;
 	float dYtoSolidBelow(int sx, float sy, int sz) const;
 
 	// entity (ladders, torches, ...) related methods
-	std::list<Entity> *getEntitiesPtr();
+	std::list<Entity> getAllEntities() const;
 	bool addEntity(Entity entity);
 	std::list<Entity> getEntitiesInArea(int minX, int maxX, int minZ, int maxZ,
 										int *numGlass, int *numStanding, int *numDoors) const;
 	bool isEntityUpdate() const;
 	bool removeEntityAt(int x, int y, int z, CubeFace cface = (CubeFace)23);
-	float distToNearestLight(float x, float y, float z) const;
 	std::list<Entity> getEntitiesAtPos(int x, int y, int z, Entity::EntityType type = (Entity::EntityType)23) const;
 	bool hasLadderOnFace(int x, int y, int z, CubeFace face) const;
 	bool hasEntities() const;
@@ -89,56 +161,172 @@ public:
 	bool isEntityDeletion() const;
 	bool openDoorAt(int x, int y, int z) const;
 	bool isEmptyOrGlass(int x, int y, int z) const;
+	// hides the faces of adjacent blocks and blocks light
+	static bool castsShadow(DATA_TYPE val);
 
 	std::list<Entity> getEntitiesOfType(Entity::EntityType etype) const;
 	
 	enum Dimensions {
-		TERRAIN_SIZE = 256,
-		CHUNK_SIZE = 16,
-		MAX_Y = 64,
-
-		MAX_X = TERRAIN_SIZE,
-		MAX_Z = TERRAIN_SIZE		
+		CHUNK_SIZE = ChunkColumn::EDGE,
+		CHUNK_SHIFT = ChunkSection::EDGE_SHIFT,
+		CHUNK_MASK = ChunkSection::EDGE_MASK,
+		MAX_Y = ChunkColumn::HEIGHT,
+
+		// the world is unbounded in x/z, but block coordinates stay positive
+		// (float positions are truncated all over the place), so new worlds
+		// start far away from the origin
+		WORLD_CENTER = 4096,
+
+		// columns are evicted once they are this many columns beyond the load radius
+		EVICT_MARGIN = 2,
+
+		// size of the fixed maps written by older versions
+		LEGACY_TERRAIN_SIZE = 256,
+		LEGACY_TERRAIN_HEIGHT = 64
 	};
 	
 	enum TexIndices {
-		INVIS_SOLID = 254,
-		INVIS_DOOR	= 255,
+		INVIS_SOLID = BlockType::INVIS_SOLID,
+		INVIS_DOOR	= BlockType::INVIS_DOOR,
 
 		CART_TEX_INDEX = 200,
-		FENCE_TEX_INDEX = 201,
-		WATER_TEX_INDEX = 10
+		FENCE_TEX_INDEX = BlockType::FENCE - 1,
+		WATER_TEX_INDEX = BlockType::WATER - 1
 	};
 
 private:
 	// terrain generation
 	void clearTerrain();
-	void generateSpherishTerrain();
-	void generateRandomTerrain(bool smallSteps);
-	void generatePerlinTerrain();
-	void generatePyramidTerrain();
-	void generateFlatTerrain(DATA_TYPE tid = 1);
+	void initGenerator();
+	void generateColumn(ChunkColumn *col) const;
+	void generateSpherishTerrain(ChunkColumn *col) const;
+	void generateRandomTerrain(ChunkColumn *col, Random *rng, bool smallSteps) const;
+	void generatePerlinTerrain(ChunkColumn *col, Random *rng) const;
+	void generatePyramidTerrain(ChunkColumn *col) const;
+	static void generateFlatTerrain(ChunkColumn *col, DATA_TYPE tid = 1);
+
+	// column management
+	ChunkColumn *findColumn(int cx, int cz) const;
+	bool loadColumn(ChunkColumn *col);
+	void storeColumn(ChunkColumn *col);
+	void invalidateColumnCache() const;
+	void importLegacyTerrain(const char *filename);
+	void setWorldFilename(const char *filename);
+
+	// height maps
+	void updateHeights(ChunkColumn *col, int lx, int y, int lz, DATA_TYPE val);
+	static void computeHeights(ChunkColumn *col);
 
 	// auxiliary methods
-	DATA_TYPE randomlyChooseTexId() const;
-	DATA_TYPE chooseTexForHeight(int blockHeight, int colHeight);
-	void addTree(int baseX, int baseY, int baseZ);
-	int roughness(int x, int z);
-	
-	DATA_TYPE data[MAX_X * MAX_Y * MAX_Z];
+	static DATA_TYPE randomlyChooseTexId(Random *rng);
+	static DATA_TYPE chooseTexForHeight(int blockHeight, int colHeight, Random *rng, int *numWaterBlocks);
+	static void addTree(ChunkColumn *col, int lx, int baseY, int lz, Random *rng);
+	void addTrees(ChunkColumn *col) const;
+	static void noisePoints(const int *xs, const int *zs, int count, float freq, float zoom, int rval, float *out);
+	void roughness(const int *xs, const int *zs, int count, int *out) const;
+	void perlinHeights(const int *xs, const int *zs, int count, int *heights) const;
+	void carveCaves(ChunkColumn *col, const int *heights) const;
+	static bool sectionDensity(int minX, int minY, int minZ, float zoom, int rval, float lo, float hi, float *out);
+	static void interpolateLattice(const float *lattice, float *out);
+
+	// entities of a chunk column, grouped by block
+	typedef std::vector<Entity> EntityCell;
+	typedef std::unordered_map<BlockPos, EntityCell, BlockPosHash> EntityCells;
+	typedef std::unordered_map<ChunkKey, EntityCells, ChunkKeyHash> EntityIndex;
+
+	const std::vector<uint> &solidSumsOf(ChunkColumn *col) const;
+	void journalBlock(int x, int y, int z, DATA_TYPE oldVal, DATA_TYPE newVal);
+	void replayJournal(bool backwards);
+	void updateDoorBits(int x, int y, int z);
+	void resolveOpenDoors(const std::vector<ChunkColumn *> &cols);
+
+	const EntityCell *findEntityCell(int x, int y, int z) const;
+	static bool hasOpenDoor(const EntityCell *cell);
+
+	bool hasTorchAt(int x, int y, int z) const;
+
+	// flood fill light, the level given by a channel's shift into the light byte
+	enum LightChannel {
+		BLOCK_LIGHT = 0,
+		SKY_LIGHT = ChunkColumn::SKY_LIGHT_SHIFT
+	};
 
-	std::list<Entity> entities;
+	struct LightNode {
+		int x, y, z;
+		// the former level of darkened nodes
+		int level;
+	};
+	typedef std::vector<LightNode> LightQueue;
+
+	int lightAt(int x, int y, int z, LightChannel ch) const;
+	void setLightAt(int x, int y, int z, LightChannel ch, int level);
+	static void computeColumnLight(ChunkColumn *col);
+	void lightColumns(const std::vector<ChunkColumn *> &cols);
+	void updateLight(int x, int y, int z, int oldSky);
+	void addTorchLight(int x, int y, int z);
+	void removeTorchLight(int x, int y, int z);
+	void spreadLight(LightQueue *queue, LightChannel ch);
+	void unspreadLight(LightQueue *queue, LightChannel ch, LightQueue *sources);
+
+	int skyHeightAt(int x, int z) const;
+	void markSectionsDirty(int x, int y, int z);
+	void markBlockChanged(int x, int y, int z);
+	void notifyDirtySections();
+
+	EntityIndex entities;
+	size_t numEntities;
+	bool entitiesModified;
 	bool entityUpdate;
 	int seed;
 
-	std::list<BlockPos> changedBlocks;
+	typedef std::unordered_map<ChunkKey, ChunkColumn::SectionMask, ChunkKeyHash> DirtySectionMap;
+	DirtySectionMap dirtySections;
+	int editDepth;
+	bool sectionUpdate;
+
+	// blocks set in the current batch by the origin of their section
+	typedef std::unordered_map<BlockPos, std::vector<BlockPos>, BlockPosHash> SectionChangeMap;
+	SectionChangeMap sectionChanges;
+	const std::vector<BlockPos> *reportedChanges;
+
+	EditJournal journal;
+	std::vector<EditJournal::Record> journalRecords;
+	// undo() and redo() aren't recorded again
+	bool replaying;
 
 	Entity *lastEntity;
 	bool deleteEntity;
 
 	BlockPos setBlockPos;
-	
-	int numWaterBlocks;
+
+	typedef std::unordered_map<ChunkKey, ChunkColumn *, ChunkKeyHash> ColumnMap;
+	ColumnMap columns;
+	// requested columns which aren't resident yet, nearest first
+	std::deque<ChunkKey> pendingColumns;
+
+	// one-entry cache, most lookups hit the column of the previous one
+	mutable ChunkColumn *cachedColumn;
+	mutable ChunkKey cachedKey;
+
+	// columns given a summed-volume table, oldest first
+	mutable std::deque<ChunkKey> summedColumns;
+
+	// evicted columns changed since the last save, NULL while a running save writes them to their region
+	WorldFile::ColumnBlobMap savedColumns;
+	WorldRegions regions;
+	std::vector<std::string> obsoleteFiles;
+	std::string worldFilename;
+
+	TerrainSource source;
+	int loadRadius;
+	int spawnX, spawnZ;
+	int perlinRval, roughnessRval;
+	int caveRvals[2], oreRval;
+	ThreadPool generatorPool;
+
+	std::thread saveThread;
+	WorldSnapshot *pendingSave;
+	std::atomic<bool> saveDone;
 
 	enum Consts {
 		MAX_SMALL_STEP_DIFF	= 5,
@@ -146,12 +334,30 @@ private:
 		DEFAULT_HEIGHT		= MAX_Y / 2,
 
 		NUM_OCTAVES		= 6,
+		// blocks per horizontal slice of a column, generated as one noise batch
+		TILE_SIZE		= CHUNK_SIZE * CHUNK_SIZE,
+
+		// caves and ores are sampled every CAVE_CELL blocks and interpolated in between
+		CAVE_CELL		= 4,
+		CAVE_LATTICE	= CHUNK_SIZE / CAVE_CELL + 1,
+		CAVE_LATTICE_SIZE = CAVE_LATTICE * CAVE_LATTICE * CAVE_LATTICE,
+		// solid blocks kept between caves and the surface
+		CAVE_CRUST		= 3,
 		TREE_TOP_TEX	= 6,
 		TREE_BASE_TEX	= 10,
+		TREE_SPACING	= 10,
+		// how far the top of a tree reaches from its trunk
+		TREE_RADIUS		= 2,
+		TREE_SEED		= 0x54726565,
 
-		MAX_BLOCKS = (MAX_X*MAX_Y*MAX_Z),
+		LEGACY_MAX_BLOCKS = (LEGACY_TERRAIN_SIZE*LEGACY_TERRAIN_HEIGHT*LEGACY_TERRAIN_SIZE),
 		MAX_WATER_BLOCKS = 320,
 
+		TORCH_LIGHT = ChunkColumn::MAX_LIGHT - 1,
+
+		// summed-volume tables kept at once, see solidSumsOf()
+		MAX_SUMMED_COLUMNS = 16,
+
 		// height used for perlin noise terrain generation
 		TMAX_Y = MAX_Y / 2
 	};
@@ -161,48 +367,151 @@ private:
 // Inlined implementations
 //===========================================================================
 
-inline bool isInvisible(int x) {
-	return ((x) == Terrain::INVIS_SOLID || (x) == Terrain::INVIS_DOOR);
-}
-
-inline bool Terrain::hasEntities() const { return !entities.empty(); }
+inline bool Terrain::hasEntities() const { return numEntities != 0; }
+inline bool Terrain::isSaving() const { return !saveDone; }
 inline Entity *Terrain::getLastEntity() { return lastEntity; }
 inline bool Terrain::isEntityDeletion() const { return deleteEntity; }
-inline DATA_TYPE *Terrain::getDataPtr() { return data; }
+
+inline void Terrain::invalidateColumnCache() const {
+	cachedColumn = NULL;
+	cachedKey = ChunkColumn::makeKey(INT_MIN, INT_MIN);
+}
+
+inline ChunkColumn *Terrain::findColumn(int cx, int cz) const {
+	ChunkKey key = ChunkColumn::makeKey(cx, cz);
+	if (key != cachedKey) {
+		ColumnMap::const_iterator it = columns.find(key);
+		cachedColumn = (it != columns.end()) ? it->second : NULL;
+		cachedKey = key;
+	}
+	return cachedColumn;
+}
+
+inline bool Terrain::isLoaded(int x, int z) const {
+	return findColumn(x >> CHUNK_SHIFT, z >> CHUNK_SHIFT) != NULL;
+}
+
+inline bool Terrain::hasPendingColumns() const { return !pendingColumns.empty(); }
+inline int Terrain::getLoadRadius() const { return loadRadius; }
+inline int Terrain::getSpawnX() const { return spawnX; }
+inline int Terrain::getSpawnZ() const { return spawnZ; }
+
+inline bool Terrain::castsShadow(DATA_TYPE val) {
+	return blockType(val).isOpaque();
+}
+
+inline void Terrain::updateHeights(ChunkColumn *col, int lx, int y, int lz, DATA_TYPE val) {
+	short &sky = col->skyHeightAt(lx, lz);
+	short &top = col->topHeightAt(lx, lz);
+
+	if (castsShadow(val)) {
+		if (y >= sky) sky = (short)(y + 1);
+	} else if (y == sky - 1) {
+		while (--sky > 0 && !castsShadow(col->get(lx, sky - 1, lz))) ;
+	}
+
+	if (val != 0) {
+		if (y >= top) top = (short)(y + 1);
+	} else if (y == top - 1) {
+		while (--top > 0 && col->get(lx, top - 1, lz) == 0) ;
+	}
+}
 
 inline void Terrain::quickSet(int x, int y, int z, DATA_TYPE val) {
-	data[x*(MAX_Y*MAX_Z)+y*MAX_Z+z] = val;
+	if ((uint)y >= (uint)MAX_Y) return;
+	ChunkColumn *col = findColumn(x >> CHUNK_SHIFT, z >> CHUNK_SHIFT);
+	if (col) {
+		col->set(x & CHUNK_MASK, y, z & CHUNK_MASK, val);
+		if (val == INVIS_DOOR && openDoorAt(x, y, z))
+			col->setSolid(x & CHUNK_MASK, y, z & CHUNK_MASK, false);
+		updateHeights(col, x & CHUNK_MASK, y, z & CHUNK_MASK, val);
+	}
+}
+
+// O(1) through the column's sky height map
+inline bool Terrain::isBlockAbove(int x, int y, int z) const {
+	if ((uint)y >= (uint)MAX_Y) return false;
+	ChunkColumn *col = findColumn(x >> CHUNK_SHIFT, z >> CHUNK_SHIFT);
+	return col && y + 1 < col->skyHeightAt(x & CHUNK_MASK, z & CHUNK_MASK);
 }
 
+inline uchar Terrain::getLight(int x, int y, int z) const {
+	if ((uint)y >= (uint)MAX_Y) return ChunkColumn::FULL_SKY_LIGHT;
+	const ChunkColumn *col = findColumn(x >> CHUNK_SHIFT, z >> CHUNK_SHIFT);
+	return col ? col->getLight(x & CHUNK_MASK, y, z & CHUNK_MASK) : (uchar)ChunkColumn::FULL_SKY_LIGHT;
+}
+
+// 0 outside of resident columns
+inline int Terrain::lightAt(int x, int y, int z, LightChannel ch) const {
+	if ((uint)y >= (uint)MAX_Y) return 0;
+	const ChunkColumn *col = findColumn(x >> CHUNK_SHIFT, z >> CHUNK_SHIFT);
+	return col ? (col->getLight(x & CHUNK_MASK, y, z & CHUNK_MASK) >> ch) & ChunkColumn::MAX_LIGHT : 0;
+}
+
+// -1 outside of resident columns
+inline int Terrain::skyHeightAt(int x, int z) const {
+	ChunkColumn *col = findColumn(x >> CHUNK_SHIFT, z >> CHUNK_SHIFT);
+	return col ? col->skyHeightAt(x & CHUNK_MASK, z & CHUNK_MASK) : -1;
+}
+
+// light changes mark the sections they touch dirty, which are reported
+// with the change or the outermost commitEdit()
 inline void Terrain::set(int x, int y, int z, DATA_TYPE val) {
+	int oldSky = skyHeightAt(x, z);
+	DATA_TYPE oldVal = get(x, y, z);
 	quickSet(x, y, z, val);
+	if (oldVal != val)
+		journalBlock(x, y, z, oldVal, val);
+	updateLight(x, y, z, oldSky);
+
+	if (editDepth > 0) {
+		markSectionsDirty(x, y, z);
+		if (oldVal != val)
+			markBlockChanged(x, y, z);
+		return;
+	}
+
 	setBlockPos.x = x;
 	setBlockPos.y = y;
 	setBlockPos.z = z;
 	entityUpdate = false;
+	sectionUpdate = false;
 	notifyObservers(&setBlockPos);
+	notifyDirtySections();
+}
+
+inline void Terrain::beginEdit(bool undoable) {
+	if (editDepth++ == 0 && undoable && !replaying)
+		journal.beginAction();
 }
 
 inline bool Terrain::isEntityUpdate() const {
 	return entityUpdate;
 }
 
-inline std::list<Entity> *Terrain::getEntitiesPtr() {
-	return &entities;
+inline bool Terrain::isSectionUpdate() const {
+	return sectionUpdate;
 }
 
+inline const std::vector<BlockPos> &Terrain::getSectionChanges() const {
+	return *reportedChanges;
+}
+
+// down to the highest block at or below sy, at most to y 0
 inline float Terrain::dYtoSolidBelow(int sx, float sy, int sz) const {
 	int y = (int)sy;
-	float dY = sy - y;
-	while (y > 0 && isEmptyPos(sx, y, sz)) {
-		dY++;
-		y--;
+	if (y > 0) {
+		y = highestSolid(sx, 1, y, sz);
+		if (y < 0) y = 0;
 	}
-	return dY;
+	return sy - y;
 }
 
+// blocks above/below the world and in columns which aren't resident read as air
 inline DATA_TYPE Terrain::get(int x, int y, int z) const {
-	return data[x*(MAX_Y*MAX_Z)+y*MAX_Z+z];
+	if ((uint)y >= (uint)MAX_Y) return 0;
+	const ChunkColumn *col = findColumn(x >> CHUNK_SHIFT, z >> CHUNK_SHIFT);
+	return col ? col->get(x & CHUNK_MASK, y, z & CHUNK_MASK) : 0;
 }
 
 inline DATA_TYPE Terrain::getValid(int x, int y, int z) const {
@@ -210,15 +519,16 @@ inline DATA_TYPE Terrain::getValid(int x, int y, int z) const {
 }
 
 inline bool Terrain::isValidIndex(int x, int y, int z) const {
-	return x >= 0 && y >= 0 && z >= 0 && x < MAX_X && y < MAX_Y && z < MAX_Z;
+	return y >= 0 && y < MAX_Y && isLoaded(x, z);
 }
 
 //==============================================================
 
+// open doors are already cleared in the solid bits
 inline bool Terrain::isEmptyPos(int x, int y, int z) const {
-	if (!isValidIndex(x, y, z))
-		return true;
-	return (get(x, y, z) == 0 || (get(x, y, z) == INVIS_DOOR && openDoorAt(x, y, z)));
+	if ((uint)y >= (uint)MAX_Y) return true;
+	const ChunkColumn *col = findColumn(x >> CHUNK_SHIFT, z >> CHUNK_SHIFT);
+	return !col || !col->isSolid(x & CHUNK_MASK, y, z & CHUNK_MASK);
 }
 inline bool Terrain::isEmptyPos(float x, float y, float z) const {
 	return isEmptyPos((int)x, (int)y, (int)z);
@@ -227,5 +537,9 @@ inline bool Terrain::isEmptyPos(Vec3 v) const {
 	return isEmptyPos(v.x, v.y, v.z);
 }
 
+inline bool Terrain::isEmptySpan(int x, int minY, int maxY, int z) const {
+	return highestSolid(x, minY, maxY, z) < 0;
+}
+
 } /* namespace as */
 #endif /* TERRAIN_HPP_ */
@@ -0,0 +1,52 @@
+// WorldConfig.hpp
+
+#ifndef WORLD_CONFIG_HPP
+#define WORLD_CONFIG_HPP
+
+/**
+ Build-time layout of the voxel world. Everything sized by world height or
+ chunk edge derives from these, so other layouts only need a recompile, e.g.
+ -DCFG_WORLD_HEIGHT=256 for taller worlds, -DCFG_CHUNK_SHIFT=5 for 32 wide chunks
+ or -DCFG_VOXEL_LAYOUT=1 for sections in Z-order.
+*/
+#ifndef CFG_WORLD_HEIGHT
+#define CFG_WORLD_HEIGHT 64
+#endif
+
+// log2 of the chunk edge length
+#ifndef CFG_CHUNK_SHIFT
+#define CFG_CHUNK_SHIFT 4
+#endif
+
+// order of the voxels within a section, see ChunkSection::localIndex()
+#ifndef CFG_VOXEL_LAYOUT
+#define CFG_VOXEL_LAYOUT 0
+#endif
+
+namespace as {
+namespace WorldConfig {
+
+enum VoxelLayout {
+	// x-major, rows along z
+	LAYOUT_LINEAR,
+	// Z-order curve, neighbours along any axis are mostly close
+	LAYOUT_MORTON,
+	// x-major bricks of 4x4x4 voxels (BRICK_SHIFT), each one linear inside
+	LAYOUT_BRICKS
+};
+
+constexpr int CHUNK_SHIFT	= CFG_CHUNK_SHIFT;
+constexpr int CHUNK_EDGE	= 1 << CHUNK_SHIFT;
+constexpr int HEIGHT		= CFG_WORLD_HEIGHT;
+constexpr int VOXEL_LAYOUT	= CFG_VOXEL_LAYOUT;
+constexpr int BRICK_SHIFT	= 2;
+
+// a section needs at least one word of 1-bit indices, and uniform sections shift all index bits away
+static_assert(CHUNK_SHIFT >= 2 && 3 * CHUNK_SHIFT < 32, "unsupported chunk edge");
+static_assert(HEIGHT > 0 && HEIGHT % CHUNK_EDGE == 0, "world height must be a multiple of the chunk edge");
+static_assert(VOXEL_LAYOUT >= LAYOUT_LINEAR && VOXEL_LAYOUT <= LAYOUT_BRICKS, "unknown voxel layout");
+
+}
+}
+
+#endif // WORLD_CONFIG_HPP
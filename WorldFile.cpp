@@ -0,0 +1,113 @@
+// WorldFile.cpp
+
+
+
+#include <cstring>
+#include <string>
+
+#include "Framework/Utilities.hpp"
+#include "Framework/ByteBuffer.hpp"
+
+#include "WorldFile.hpp"
+
+namespace as {
+
+enum WorldFileLayout {
+	HEADER_SIZE = 10 * 4,
+	SECTION_ENTRY_SIZE = 3 * 4
+};
+
+WorldFile::WorldFile() {
+	memset(&info, 0, sizeof(info));
+}
+
+bool WorldFile::load(const char *filename) {
+	if (!fileExists(filename))
+		return false;
+
+	uchar header[HEADER_SIZE];
+	memset(header, 0, sizeof(header));
+	binaryRead(filename, header, HEADER_SIZE);
+
+	ByteReader hr(header, HEADER_SIZE);
+	if (hr.getInt() != MAGIC)
+		return false;
+	if (hr.getInt() != VERSION)
+		return false;
+
+	info.height = hr.getInt();
+	info.chunkShift = hr.getInt();
+	info.source = hr.getInt();
+	info.seed = hr.getInt();
+	info.spawnX = hr.getInt();
+	info.spawnZ = hr.getInt();
+	int fileSize = hr.getInt();
+	int numSections = hr.getInt();
+
+	if (fileSize < HEADER_SIZE || numSections < 0 || numSections > (fileSize - HEADER_SIZE) / SECTION_ENTRY_SIZE)
+		error("World file is damaged!");
+
+	std::vector<uchar> buf(fileSize);
+	binaryRead(filename, &buf[0], fileSize);
+
+	ByteReader r(&buf[0] + HEADER_SIZE, fileSize - HEADER_SIZE);
+	for (int i = 0; i < numSections; i++) {
+		int tag = r.getInt();
+		int offset = r.getInt();
+		int size = r.getInt();
+
+		if (offset < HEADER_SIZE || size < 0 || size > fileSize - offset)
+			error("World file is damaged!");
+
+		if (tag > SEC_UNUSED && tag < NUM_SECTION_TAGS)
+			sections[tag].assign(&buf[offset], &buf[offset] + size);
+	}
+
+	return true;
+}
+
+void WorldFile::save(const char *filename) const {
+	std::vector<uchar> buf;
+	ByteWriter w(&buf);
+
+	w.putInt(MAGIC);
+	w.putInt(VERSION);
+	w.putInt(info.height);
+	w.putInt(info.chunkShift);
+	w.putInt(info.source);
+	w.putInt(info.seed);
+	w.putInt(info.spawnX);
+	w.putInt(info.spawnZ);
+	size_t fileSizePos = w.size();
+	w.putInt(0);
+
+	int numSections = 0;
+	for (int tag = 0; tag < NUM_SECTION_TAGS; tag++) {
+		if (!sections[tag].empty())
+			numSections++;
+	}
+	w.putInt(numSections);
+
+	int offset = HEADER_SIZE + numSections * SECTION_ENTRY_SIZE;
+	for (int tag = 0; tag < NUM_SECTION_TAGS; tag++) {
+		if (sections[tag].empty()) continue;
+		w.putInt(tag);
+		w.putInt(offset);
+		w.putInt((int)sections[tag].size());
+		offset += (int)sections[tag].size();
+	}
+
+	for (int tag = 0; tag < NUM_SECTION_TAGS; tag++) {
+		if (!sections[tag].empty())
+			w.putBytes(&sections[tag][0], sections[tag].size());
+	}
+
+	w.patchInt(fileSizePos, (int)w.size());
+
+	// a save interrupted by a crash leaves the previous file intact
+	std::string tmpFilename = std::string(filename) + ".tmp";
+	binaryWrite(tmpFilename.c_str(), &buf[0], buf.size());
+	renameFile(tmpFilename.c_str(), filename);
+}
+
+}
@@ -0,0 +1,83 @@
+// WorldFile.hpp
+
+#ifndef WORLD_FILE_HPP
+#define WORLD_FILE_HPP
+
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include "ChunkColumn.hpp"
+
+namespace as {
+
+/**
+ The main file of a world, all values little endian:
+
+	header			magic, version, world layout, generator, spawn, file size, number of sections
+	section table	tag, offset and size of each section
+	sections		entities, animals, player, regions
+
+ The columns live in region files (see WorldRegions), the region section
+ lists their coordinates. Unknown sections are skipped, so newer versions
+ can add some.
+*/
+class WorldFile {
+public:
+	enum Consts {
+		MAGIC = 0x44574B53, // "SKWD"
+		VERSION = 3
+	};
+
+	enum SectionTag {
+		SEC_UNUSED, // held the columns before there were region files
+		SEC_ENTITIES,
+		SEC_ANIMALS,
+		SEC_PLAYER,
+		SEC_REGIONS,
+		NUM_SECTION_TAGS
+	};
+
+	struct Info {
+		int height, chunkShift;
+		int source, seed;
+		int spawnX, spawnZ;
+	};
+
+	// encoded blocks of a column, shared by the terrain and snapshots
+	typedef std::shared_ptr<const std::vector<uchar> > ColumnBlob;
+	typedef std::unordered_map<ChunkKey, ColumnBlob, ChunkKeyHash> ColumnBlobMap;
+
+	WorldFile();
+
+	// false if the file doesn't exist or is of another version
+	bool load(const char *filename);
+	void save(const char *filename) const;
+
+	const Info &getInfo() const;
+	void setInfo(const Info &info);
+
+	// empty if the file has no such section
+	const std::vector<uchar> &getSection(SectionTag tag) const;
+	void setSection(SectionTag tag, std::vector<uchar> *data);
+
+private:
+	Info info;
+	std::vector<uchar> sections[NUM_SECTION_TAGS];
+};
+
+//===========================================================================
+// Inlined implementations
+//===========================================================================
+inline const WorldFile::Info &WorldFile::getInfo() const { return info; }
+inline void WorldFile::setInfo(const Info &_info) { info = _info; }
+inline const std::vector<uchar> &WorldFile::getSection(SectionTag tag) const { return sections[tag]; }
+
+// takes over the contents of data
+inline void WorldFile::setSection(SectionTag tag, std::vector<uchar> *data) {
+	sections[tag].swap(*data);
+}
+
+}
+
+#endif // WORLD_FILE_HPP
@@ -0,0 +1,132 @@
+// WorldRegions.cpp
+
+
+
+#include <cstdio>
+
+#include "Framework/Utilities.hpp"
+#include "Framework/ByteBuffer.hpp"
+
+#include "WorldRegions.hpp"
+
+namespace as {
+
+WorldRegions::WorldRegions() {}
+
+WorldRegions::~WorldRegions() {
+	close();
+}
+
+void WorldRegions::open(const std::string &_worldFilename, const std::vector<uchar> &regionList) {
+	close();
+
+	std::lock_guard<std::mutex> lock(mutex);
+	worldFilename = _worldFilename;
+	parseRegionList(regionList, &regionKeys);
+}
+
+void WorldRegions::close() {
+	std::lock_guard<std::mutex> lock(mutex);
+	RegionMap::iterator it;
+	for (it = openRegions.begin(); it != openRegions.end(); ++it) {
+		SAFE_DELETE(it->second);
+	}
+	openRegions.clear();
+	regionKeys.clear();
+	worldFilename.clear();
+}
+
+RegionFile *WorldRegions::findRegion(ChunkKey regionKey, bool create) {
+	RegionMap::iterator it = openRegions.find(regionKey);
+	if (it != openRegions.end())
+		return it->second;
+
+	std::string filename = regionFilename(worldFilename, regionKey);
+	if (!regionKeys.count(regionKey)) {
+		if (!create) return NULL;
+		// left over from a deleted world of the same name
+		if (fileExists(filename.c_str()))
+			deleteFile(filename.c_str());
+		regionKeys.insert(regionKey);
+	}
+
+	RegionFile *region = new RegionFile(filename, (int)(regionKey >> 32), (int)regionKey);
+	openRegions[regionKey] = region;
+	return region;
+}
+
+bool WorldRegions::read(ChunkKey key, std::vector<uchar> *blob) {
+	std::lock_guard<std::mutex> lock(mutex);
+	RegionFile *region = findRegion(RegionFile::regionOf(key), false);
+	return region && region->read(key, blob);
+}
+
+void WorldRegions::write(ChunkKey key, const std::vector<uchar> &blob) {
+	std::lock_guard<std::mutex> lock(mutex);
+	findRegion(RegionFile::regionOf(key), true)->write(key, blob);
+}
+
+void WorldRegions::readAll(WorldFile::ColumnBlobMap *blobs) {
+	std::lock_guard<std::mutex> lock(mutex);
+	std::vector<ChunkKey> keys;
+
+	std::set<ChunkKey>::const_iterator it;
+	for (it = regionKeys.begin(); it != regionKeys.end(); ++it) {
+		RegionFile *region = findRegion(*it, false);
+		keys.clear();
+		region->getColumnKeys(&keys);
+
+		for (size_t i = 0; i < keys.size(); i++) {
+			std::vector<uchar> *blob = new std::vector<uchar>();
+			region->read(keys[i], blob);
+			(*blobs)[keys[i]] = WorldFile::ColumnBlob(blob);
+		}
+	}
+}
+
+void WorldRegions::exportRegionList(std::vector<uchar> *regionList) const {
+	std::lock_guard<std::mutex> lock(mutex);
+	ByteWriter w(regionList);
+	w.putInt((int)regionKeys.size());
+
+	std::set<ChunkKey>::const_iterator it;
+	for (it = regionKeys.begin(); it != regionKeys.end(); ++it) {
+		w.putInt((int)(*it >> 32));
+		w.putInt((int)*it);
+	}
+}
+
+void WorldRegions::parseRegionList(const std::vector<uchar> &regionList, std::set<ChunkKey> *keys) {
+	if (regionList.empty()) return;
+
+	ByteReader r(&regionList[0], regionList.size());
+	int numRegions = r.getInt();
+	for (int i = 0; i < numRegions && r.ok(); i++) {
+		int rx = r.getInt();
+		int rz = r.getInt();
+		keys->insert(ChunkColumn::makeKey(rx, rz));
+	}
+
+	if (!r.ok())
+		error("World file is damaged!");
+}
+
+void WorldRegions::deleteFiles(const std::string &worldFilename, const std::vector<uchar> &regionList) {
+	std::set<ChunkKey> keys;
+	parseRegionList(regionList, &keys);
+
+	std::set<ChunkKey>::const_iterator it;
+	for (it = keys.begin(); it != keys.end(); ++it) {
+		std::string filename = regionFilename(worldFilename, *it);
+		if (fileExists(filename.c_str()))
+			deleteFile(filename.c_str());
+	}
+}
+
+std::string WorldRegions::regionFilename(const std::string &worldFilename, ChunkKey regionKey) {
+	char buf[BUF_LEN];
+	std::sprintf(buf, "%s.r%d_%d", worldFilename.c_str(), (int)(regionKey >> 32), (int)regionKey);
+	return buf;
+}
+
+}
@@ -0,0 +1,58 @@
+// WorldRegions.hpp
+
+#ifndef WORLD_REGIONS_HPP
+#define WORLD_REGIONS_HPP
+
+#include <mutex>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "RegionFile.hpp"
+#include "WorldFile.hpp"
+
+namespace as {
+
+/**
+ The region files "<world file>.r<x>_<z>" holding the columns of a world.
+ Columns are read on demand by the game and written by background saves,
+ so all methods may be called from either thread.
+*/
+class WorldRegions {
+public:
+	WorldRegions();
+	~WorldRegions();
+
+	// regionList: SEC_REGIONS of the world file, empty for new worlds
+	void open(const std::string &worldFilename, const std::vector<uchar> &regionList);
+	void close();
+
+	bool read(ChunkKey key, std::vector<uchar> *blob);
+	void write(ChunkKey key, const std::vector<uchar> &blob);
+	// every column of every region, e.g. to save the world under another name
+	void readAll(WorldFile::ColumnBlobMap *blobs);
+
+	void exportRegionList(std::vector<uchar> *regionList) const;
+	static void deleteFiles(const std::string &worldFilename, const std::vector<uchar> &regionList);
+
+private:
+	WorldRegions(const WorldRegions &);
+	WorldRegions &operator=(const WorldRegions &);
+
+	RegionFile *findRegion(ChunkKey regionKey, bool create);
+	static void parseRegionList(const std::vector<uchar> &regionList, std::set<ChunkKey> *keys);
+	static std::string regionFilename(const std::string &worldFilename, ChunkKey regionKey);
+
+	typedef std::unordered_map<ChunkKey, RegionFile *, ChunkKeyHash> RegionMap;
+
+	mutable std::mutex mutex;
+	std::string worldFilename;
+	// regions which have a file, only opened when first accessed
+	std::set<ChunkKey> regionKeys;
+	RegionMap openRegions;
+};
+
+}
+
+#endif // WORLD_REGIONS_HPP
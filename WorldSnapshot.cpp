@@ -0,0 +1,60 @@
+// WorldSnapshot.cpp
+
+
+
+#include "Framework/Utilities.hpp"
+
+#include "ChunkColumn.hpp"
+#include "WorldRegions.hpp"
+#include "WorldSnapshot.hpp"
+
+namespace as {
+
+WorldSnapshot::WorldSnapshot() : regions(NULL) {}
+
+WorldSnapshot::~WorldSnapshot() {
+	for (size_t i = 0; i < columns.size(); i++) {
+		SAFE_DELETE(columns[i]);
+	}
+}
+
+void WorldSnapshot::addColumn(ColumnBlocks *col) {
+	columns.push_back(col);
+}
+
+void WorldSnapshot::addColumn(ChunkKey key, const WorldFile::ColumnBlob &blob) {
+	blobs[key] = blob;
+}
+
+void WorldSnapshot::addObsoleteFile(const std::string &obsoleteFile) {
+	obsoleteFiles.push_back(obsoleteFile);
+}
+
+void WorldSnapshot::write() {
+	std::vector<uchar> blob;
+	for (size_t i = 0; i < columns.size(); i++) {
+		blob.clear();
+		columns[i]->encode(&blob);
+		regions->write(columns[i]->getKey(), blob);
+		SAFE_DELETE(columns[i]);
+	}
+	columns.clear();
+
+	WorldFile::ColumnBlobMap::const_iterator it;
+	for (it = blobs.begin(); it != blobs.end(); ++it) {
+		regions->write(it->first, *it->second);
+	}
+
+	// the world file only refers to regions once they hold the columns
+	std::vector<uchar> regionList;
+	regions->exportRegionList(&regionList);
+	file.setSection(WorldFile::SEC_REGIONS, &regionList);
+	file.save(filename.c_str());
+
+	for (size_t i = 0; i < obsoleteFiles.size(); i++) {
+		if (fileExists(obsoleteFiles[i].c_str()))
+			deleteFile(obsoleteFiles[i].c_str());
+	}
+}
+
+}
@@ -0,0 +1,66 @@
+// WorldSnapshot.hpp
+
+#ifndef WORLD_SNAPSHOT_HPP
+#define WORLD_SNAPSHOT_HPP
+
+#include <string>
+#include <vector>
+
+#include "WorldFile.hpp"
+
+namespace as {
+
+class ColumnBlocks;
+class WorldRegions;
+
+/**
+ Everything a save writes, copied on the main thread so that write() can run
+ on a background thread while the game goes on. Of modified columns only the
+ blocks are copied (ColumnBlocks), which share their section storage with the
+ live terrain until either side is modified, and only encoded by write().
+ Only columns changed since the previous save are written to their regions.
+*/
+class WorldSnapshot {
+public:
+	WorldSnapshot();
+	~WorldSnapshot();
+
+	WorldFile &getFile();
+	const WorldFile &getFile() const;
+	void setFilename(const std::string &filename);
+	void setRegions(WorldRegions *regions);
+
+	// takes ownership of col
+	void addColumn(ColumnBlocks *col);
+	// a column which was encoded when it was streamed out
+	void addColumn(ChunkKey key, const WorldFile::ColumnBlob &blob);
+	const WorldFile::ColumnBlobMap &getColumnBlobs() const;
+	// files made redundant by this save, e.g. those of older world versions
+	void addObsoleteFile(const std::string &filename);
+
+	void write();
+
+private:
+	WorldSnapshot(const WorldSnapshot &);
+	WorldSnapshot &operator=(const WorldSnapshot &);
+
+	std::string filename;
+	WorldFile file;
+	WorldRegions *regions;
+	std::vector<ColumnBlocks *> columns;
+	WorldFile::ColumnBlobMap blobs;
+	std::vector<std::string> obsoleteFiles;
+};
+
+//===========================================================================
+// Inlined implementations
+//===========================================================================
+inline WorldFile &WorldSnapshot::getFile() { return file; }
+inline const WorldFile &WorldSnapshot::getFile() const { return file; }
+inline void WorldSnapshot::setFilename(const std::string &_filename) { filename = _filename; }
+inline const WorldFile::ColumnBlobMap &WorldSnapshot::getColumnBlobs() const { return blobs; }
+inline void WorldSnapshot::setRegions(WorldRegions *_regions) { regions = _regions; }
+
+}
+
+#endif // WORLD_SNAPSHOT_HPP